@@ -0,0 +1,264 @@
+#include "BVH.h"
+#include "MengerTrace.h"
+
+
+// bvh build
+
+static const int numBins = 12;
+
+void BVH::build(const vector<AABB>& boxes) {
+	nodes.clear();
+	indices.resize(boxes.size());
+	if (boxes.empty()) return;
+
+	vector<glm::vec3> centroids(boxes.size());
+	for (uint32_t i = 0; i < boxes.size(); i++) {
+		indices[i] = i;
+		centroids[i] = boxes[i].center();
+	}
+
+	// a binary tree with n leaves never needs more than 2n - 1 nodes, reserving
+	// them up front keeps node references valid while subdividing
+	nodes.reserve(boxes.size() * 2);
+	nodes.push_back({ AABB(), 0, (uint32_t)boxes.size() });
+	updateBounds(0, boxes);
+	subdivide(0, 0, boxes, centroids);
+}
+
+void BVH::updateBounds(uint32_t node, const vector<AABB>& boxes) {
+	BVHNode& n = nodes[node];
+	n.bounds = AABB();
+	for (uint32_t i = 0; i < n.count; i++) {
+		n.bounds.grow(boxes[indices[n.first + i]]);
+	}
+}
+
+void BVH::subdivide(uint32_t node, int depth, const vector<AABB>& boxes, const vector<glm::vec3>& centroids) {
+	BVHNode& n = nodes[node];
+	if (n.count <= 1 || depth >= maxDepth - 2) return;
+
+	// bin the primitive centroids along each axis and sweep the bin boundaries
+	// for the split with the lowest surface area cost
+	AABB centroidBounds;
+	for (uint32_t i = 0; i < n.count; i++) {
+		centroidBounds.grow(centroids[indices[n.first + i]]);
+	}
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::infinity();
+
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+		if (extent <= 0) continue;
+
+		AABB binBounds[numBins];
+		int binCount[numBins] = {};
+		float scale = numBins / extent;
+		for (uint32_t i = 0; i < n.count; i++) {
+			uint32_t prim = indices[n.first + i];
+			int b = glm::min(numBins - 1, (int)((centroids[prim][axis] - centroidBounds.min[axis]) * scale));
+			binCount[b]++;
+			binBounds[b].grow(boxes[prim]);
+		}
+
+		float leftArea[numBins - 1], rightArea[numBins - 1];
+		int leftCount[numBins - 1], rightCount[numBins - 1];
+		AABB leftBox, rightBox;
+		int leftSum = 0, rightSum = 0;
+		for (int i = 0; i < numBins - 1; i++) {
+			leftSum += binCount[i];
+			leftBox.grow(binBounds[i]);
+			leftCount[i] = leftSum;
+			leftArea[i] = leftBox.area();
+
+			rightSum += binCount[numBins - 1 - i];
+			rightBox.grow(binBounds[numBins - 1 - i]);
+			rightCount[numBins - 2 - i] = rightSum;
+			rightArea[numBins - 2 - i] = rightBox.area();
+		}
+
+		for (int i = 0; i < numBins - 1; i++) {
+			float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// keep the leaf if no split is cheaper than testing every primitive in it
+	float leafCost = n.count * n.bounds.area();
+	if (bestAxis < 0 || bestCost >= leafCost) return;
+
+	// partition the primitives around the chosen bin boundary
+	float scale = numBins / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+	uint32_t i = n.first;
+	uint32_t j = n.first + n.count;
+	while (i < j) {
+		int b = glm::min(numBins - 1, (int)((centroids[indices[i]][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+		if (b <= bestSplit) {
+			i++;
+		}
+		else {
+			std::swap(indices[i], indices[--j]);
+		}
+	}
+
+	uint32_t leftCount = i - n.first;
+	if (leftCount == 0 || leftCount == n.count) return;
+
+	uint32_t left = (uint32_t)nodes.size();
+	nodes.push_back({ AABB(), n.first, leftCount });
+	nodes.push_back({ AABB(), i, n.count - leftCount });
+	n.first = left;
+	n.count = 0;
+
+	updateBounds(left, boxes);
+	updateBounds(left + 1, boxes);
+	subdivide(left, depth + 1, boxes, centroids);
+	subdivide(left + 1, depth + 1, boxes, centroids);
+}
+
+
+// scene bvh
+
+void SceneBVH::build(const RenderScene& scene) {
+	this->scene = &scene;
+	kernels = &PacketKernels::get();
+
+	primitives.clear();
+	for (uint32_t i = 0; i < scene.sphereCenter.size(); i++) primitives.push_back({ PRIM_SPHERE, i });
+	for (uint32_t i = 0; i < scene.planeRect.size(); i++) {
+		// planes that aren't axis aligned are never hit
+		if (scene.planeRect[i].axis >= 0) primitives.push_back({ PRIM_PLANE, i });
+	}
+	for (uint32_t i = 0; i < scene.mengerCenter.size(); i++) primitives.push_back({ PRIM_MENGER, i });
+	for (uint32_t i = 0; i < scene.bulbCenter.size(); i++) primitives.push_back({ PRIM_BULB, i });
+
+	vector<AABB> boxes;
+	for (const Primitive& prim : primitives) {
+		boxes.push_back(getBounds(prim));
+	}
+	bvh.build(boxes);
+}
+
+AABB SceneBVH::getBounds(const Primitive& prim) const {
+	switch (prim.type) {
+	case PRIM_SPHERE: {
+		glm::vec3 r(scene->sphereRadius[prim.index]);
+		return AABB(scene->sphereCenter[prim.index] - r, scene->sphereCenter[prim.index] + r);
+	}
+	case PRIM_PLANE:
+		return scene->planeRect[prim.index].getBounds();
+	case PRIM_MENGER: {
+		glm::vec3 r(scene->mengerSize[prim.index] / 2);
+		return AABB(scene->mengerCenter[prim.index] - r, scene->mengerCenter[prim.index] + r);
+	}
+	case PRIM_BULB:
+		return AABB(scene->bulbCenter[prim.index] - glm::vec3(1), scene->bulbCenter[prim.index] + glm::vec3(1));
+	}
+	return AABB();
+}
+
+uint32_t SceneBVH::getMaterial(const Primitive& prim) const {
+	switch (prim.type) {
+	case PRIM_SPHERE: return scene->sphereMaterial[prim.index];
+	case PRIM_PLANE: return scene->planeMaterial[prim.index];
+	case PRIM_MENGER: return scene->mengerMaterial[prim.index];
+	case PRIM_BULB: return scene->bulbMaterial[prim.index];
+	}
+	return 0;
+}
+
+// test one primitive against every lane of a packet
+int SceneBVH::intersectPacket(uint32_t index, RayPacket& packet) {
+	const Primitive& prim = primitives[index];
+	switch (prim.type) {
+	case PRIM_SPHERE:
+		return kernels->intersectSphere(packet, scene->sphereCenter[prim.index], scene->sphereRadius[prim.index], index);
+	case PRIM_PLANE:
+		return kernels->intersectPlane(packet, scene->planeRect[prim.index], index);
+	case PRIM_MENGER:
+		return intersectMengerPacket(prim.index, packet, index);
+	case PRIM_BULB:
+		return kernels->intersectSphere(packet, scene->bulbCenter[prim.index], 1, index);
+	}
+	return 0;
+}
+
+// the sponge traversal branches too much for simd, each lane walks it on its own
+int SceneBVH::intersectMengerPacket(uint32_t menger, RayPacket& packet, int id) const {
+	int mask = 0;
+	for (int k = 0; k < packet.count; k++) {
+		if (!(packet.tMax[k] > 0)) continue;
+
+		float t;
+		glm::vec3 normal;
+		if (intersectMenger(packet.getRay(k), scene->mengerCenter[menger], scene->mengerSize[menger], scene->mengerLevel[menger],
+			packet.tMax[k], t, normal)) {
+			packet.tMax[k] = t;
+			packet.hit[k] = id;
+			mask |= 1 << k;
+		}
+	}
+	return mask;
+}
+
+void SceneBVH::intersect(RayPacket& packet, RayHit* hits) {
+	bvh.intersect(packet, [&](uint32_t i) { intersectPacket(i, packet); });
+
+	for (int k = 0; k < packet.count; k++) {
+		hits[k] = RayHit();
+		if (packet.hit[k] < 0) continue;
+
+		const Primitive& prim = primitives[packet.hit[k]];
+		Ray ray = packet.getRay(k);
+		hits[k].t = packet.tMax[k];
+		hits[k].point = ray.p + packet.tMax[k] * ray.d;
+		hits[k].material = getMaterial(prim);
+		switch (prim.type) {
+		case PRIM_SPHERE: hits[k].normal = glm::normalize(hits[k].point - scene->sphereCenter[prim.index]); break;
+		case PRIM_PLANE: hits[k].normal = scene->planeNormal[prim.index]; break;
+		case PRIM_MENGER: {
+			// the face isn't kept per lane, find the same hit again for its normal
+			float t;
+			intersectMenger(ray, scene->mengerCenter[prim.index], scene->mengerSize[prim.index], scene->mengerLevel[prim.index],
+				hits[k].t * 1.001f + mengerMinHitDistance, t, hits[k].normal);
+			break;
+		}
+		case PRIM_BULB: hits[k].normal = glm::normalize(hits[k].point - scene->bulbCenter[prim.index]); break;
+		}
+	}
+}
+
+int SceneBVH::occluded(ShadowBatch& batch) {
+	RayPacket packet;
+
+	// a lane is done as soon as anything blocks it
+	auto block = [&](uint32_t index) {
+		int mask = intersectPacket(index, packet);
+		for (int k = 0; k < packet.count; k++) {
+			if (mask & (1 << k)) packet.tMax[k] = -1;
+		}
+	};
+
+	int numBlocked = 0;
+	for (int first = 0; first < batch.size(); first += RayPacket::width) {
+		int count = glm::min(RayPacket::width, batch.size() - first);
+		packet.clear();
+		for (int k = 0; k < count; k++) {
+			packet.add(batch.rays[first + k], batch.blocked[first + k] ? -1 : batch.tMax[first + k]);
+		}
+		packet.pad();
+
+		bvh.intersect(packet, block);
+
+		for (int k = 0; k < count; k++) {
+			if (packet.hit[k] >= 0) batch.blocked[first + k] = 1;
+			if (batch.blocked[first + k]) numBlocked++;
+		}
+	}
+	return numBlocked;
+}
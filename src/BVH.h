@@ -0,0 +1,235 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Primitives.h"
+#include "PacketKernels.h"
+#include "RenderScene.h"
+#include <cstdint>
+
+
+// 32 byte node, the two children of an inner node are always stored next to each other
+struct BVHNode {
+	AABB bounds;
+	uint32_t first;     // leaf: first entry in BVH::indices, inner node: index of the left child
+	uint32_t count;     // number of primitives in a leaf, 0 for inner nodes
+
+	bool isLeaf() const { return count > 0; }
+};
+
+
+//  batch of shadow rays, usually from one point toward the samples of one light
+//  kept per render thread so the buffers are only allocated once
+struct ShadowBatch {
+	void clear() { rays.clear(); tMax.clear(); blocked.clear(); }
+	void add(const Ray& ray, float maxDist) {
+		rays.push_back(ray);
+		tMax.push_back(maxDist);
+		blocked.push_back(0);
+	}
+	int size() const { return (int)rays.size(); }
+
+	vector<Ray> rays;
+	vector<float> tMax;         // only occluders closer than this count, e.g. the distance to the light
+	vector<uint8_t> blocked;    // set by the occlusion query
+};
+
+
+//  bounding volume hierarchy over a list of boxes, built with a binned surface area
+//  heuristic and stored as one flat array of nodes
+//
+//  the tree only knows primitive indices, the traversal calls back into the
+//  caller to test the primitives in a leaf
+class BVH {
+public:
+	void build(const vector<AABB>& boxes);
+	void clear() { nodes.clear(); indices.clear(); }
+	bool isEmpty() const { return nodes.empty(); }
+
+	// packet traversal: a node is visited if any live lane of the packet hits its box,
+	// hitPrimitive(index) tests a primitive against the whole packet and lowers tMax
+	// for the lanes it hits
+	template <class HitFn>
+	void intersect(RayPacket& packet, HitFn hitPrimitive) const;
+
+	// branch and bound nearest primitive to p: nodes further away than best are
+	// skipped, distPrimitive(index, best) evaluates one primitive and lowers best
+	template <class DistFn>
+	void nearest(const glm::vec3& p, float& best, DistFn distPrimitive) const;
+
+	// nearest() for count points at once: a node is visited if it is closer than best
+	// for any of the points, leafPrimitive(index) evaluates a primitive for all of them
+	// and lowers their best
+	template <class LeafFn>
+	void nearest(const glm::vec3* p, int count, const float* best, LeafFn leafPrimitive) const;
+
+	vector<BVHNode> nodes;
+	vector<uint32_t> indices;   // primitive indices, leaves point at ranges of this
+
+	static const int maxDepth = 64;
+
+private:
+	void subdivide(uint32_t node, int depth, const vector<AABB>& boxes, const vector<glm::vec3>& centroids);
+	void updateBounds(uint32_t node, const vector<AABB>& boxes);
+};
+
+
+template <class HitFn>
+void BVH::intersect(RayPacket& packet, HitFn hitPrimitive) const {
+	if (nodes.empty()) return;
+
+	// the lanes are coherent, so the first ray decides which child is nearer
+	glm::vec3 dir = packet.getRay(0).d;
+
+	uint32_t stack[maxDepth];
+	int size = 0;
+	stack[size++] = 0;
+
+	while (size > 0) {
+		const BVHNode& n = nodes[stack[--size]];
+		if (!packet.hitsBox(n.bounds)) continue;
+
+		if (n.isLeaf()) {
+			for (uint32_t i = 0; i < n.count; i++) {
+				hitPrimitive(indices[n.first + i]);
+			}
+		}
+		else {
+			glm::vec3 offset = nodes[n.first + 1].bounds.center() - nodes[n.first].bounds.center();
+			bool leftFirst = glm::dot(offset, dir) >= 0;
+			stack[size++] = leftFirst ? n.first + 1 : n.first;
+			stack[size++] = leftFirst ? n.first : n.first + 1;
+		}
+	}
+}
+
+template <class DistFn>
+void BVH::nearest(const glm::vec3& p, float& best, DistFn distPrimitive) const {
+	if (nodes.empty() || nodes[0].bounds.distance(p) >= best) return;
+
+	// nearer child first, the other one waits on the stack together with its distance
+	// and is skipped once best has shrunk below it
+	struct Entry { uint32_t node; float dist; };
+	Entry stack[maxDepth];
+	int size = 0;
+
+	uint32_t node = 0;
+	for (;;) {
+		const BVHNode& n = nodes[node];
+		if (n.isLeaf()) {
+			for (uint32_t i = 0; i < n.count; i++) {
+				distPrimitive(indices[n.first + i], best);
+			}
+		}
+		else {
+			float dLeft = nodes[n.first].bounds.distance(p);
+			float dRight = nodes[n.first + 1].bounds.distance(p);
+			bool nearLeft = dLeft < best;
+			bool nearRight = dRight < best;
+			if (nearLeft && nearRight) {
+				if (dLeft <= dRight) {
+					stack[size++] = { n.first + 1, dRight };
+					node = n.first;
+				}
+				else {
+					stack[size++] = { n.first, dLeft };
+					node = n.first + 1;
+				}
+				continue;
+			}
+			if (nearLeft || nearRight) {
+				node = nearLeft ? n.first : n.first + 1;
+				continue;
+			}
+		}
+
+		do {
+			if (size == 0) return;
+			size--;
+		} while (stack[size].dist >= best);
+		node = stack[size].node;
+	}
+}
+
+
+template <class LeafFn>
+void BVH::nearest(const glm::vec3* p, int count, const float* best, LeafFn leafPrimitive) const {
+	if (nodes.empty()) return;
+
+	auto isNear = [&](const AABB& box) {
+		for (int k = 0; k < count; k++) {
+			if (box.distance(p[k]) < best[k]) return true;
+		}
+		return false;
+	};
+
+	uint32_t stack[maxDepth];
+	int size = 0;
+	stack[size++] = 0;
+
+	while (size > 0) {
+		const BVHNode& n = nodes[stack[--size]];
+		if (!isNear(n.bounds)) continue;
+
+		if (n.isLeaf()) {
+			for (uint32_t i = 0; i < n.count; i++) {
+				leafPrimitive(indices[n.first + i]);
+			}
+		}
+		else {
+			// the points are close together, so the first one decides which child is nearer
+			bool leftFirst = nodes[n.first].bounds.distance(p[0]) <= nodes[n.first + 1].bounds.distance(p[0]);
+			stack[size++] = leftFirst ? n.first + 1 : n.first;
+			stack[size++] = leftFirst ? n.first : n.first + 1;
+		}
+	}
+}
+
+// closest intersection found by SceneBVH
+struct RayHit {
+	float t = std::numeric_limits<float>::infinity();
+	glm::vec3 point;
+	glm::vec3 normal;
+	int material = -1;      // index into RenderScene::materials, -1 = no hit
+};
+
+
+//  BVH over the ray traced primitives of a RenderScene: spheres, axis aligned planes,
+//  the faces of menger sponges and the bounding spheres of mandelbulbs. primitives
+//  only point into the scene's arrays and are tested in packets with the simd kernels
+class SceneBVH {
+public:
+	void build(const RenderScene& scene);
+
+	// closest hits for every lane of a packet, hits needs one entry per lane
+	void intersect(RayPacket& packet, RayHit* hits);
+
+	// marks the blocked rays of a shadow batch and returns how many there are,
+	// the batch is traced in packets
+	int occluded(ShadowBatch& batch);
+
+	int primitiveCount() const { return (int)primitives.size(); }
+	const char* kernelName() const { return kernels ? kernels->name : ""; }
+
+private:
+	enum PrimitiveType : uint32_t {
+		PRIM_SPHERE,
+		PRIM_PLANE,
+		PRIM_MENGER,
+		PRIM_BULB       // mandelbulb bounding sphere
+	};
+
+	struct Primitive {
+		PrimitiveType type;
+		uint32_t index;         // into the scene's arrays for that type
+	};
+
+	int intersectPacket(uint32_t prim, RayPacket& packet);
+	int intersectMengerPacket(uint32_t menger, RayPacket& packet, int id) const;
+	AABB getBounds(const Primitive& prim) const;
+	uint32_t getMaterial(const Primitive& prim) const;
+
+	const RenderScene* scene = NULL;
+	vector<Primitive> primitives;   // in bvh order of the build, bvh indices point here
+	BVH bvh;
+	const PacketKernels* kernels = NULL;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ofMain.h"
+
+
+//  dual numbers for forward mode automatic differentiation
+//
+//  a Dual carries a value together with its gradient with respect to a point in
+//  space. the sdf functions in SDF.h are templates over the vector type, evaluated on
+//  DualVec3::variable(p) they return the distance and its gradient (the surface
+//  normal) in one go, without finite differences
+
+
+struct Dual {
+	Dual(float v = 0) : v(v), d(0) {}
+	Dual(float v, const glm::vec3& d) : v(v), d(d) {}
+
+	float v;            // value
+	glm::vec3 d;        // gradient
+};
+
+inline Dual operator-(const Dual& a) { return Dual(-a.v, -a.d); }
+inline Dual operator+(const Dual& a, const Dual& b) { return Dual(a.v + b.v, a.d + b.d); }
+inline Dual operator-(const Dual& a, const Dual& b) { return Dual(a.v - b.v, a.d - b.d); }
+inline Dual operator*(const Dual& a, const Dual& b) { return Dual(a.v * b.v, a.d * b.v + b.d * a.v); }
+inline Dual operator/(const Dual& a, const Dual& b) { return Dual(a.v / b.v, (a.d * b.v - b.d * a.v) / (b.v * b.v)); }
+inline Dual& operator+=(Dual& a, const Dual& b) { return a = a + b; }
+inline Dual& operator*=(Dual& a, const Dual& b) { return a = a * b; }
+
+inline bool operator<(const Dual& a, const Dual& b) { return a.v < b.v; }
+inline bool operator>(const Dual& a, const Dual& b) { return a.v > b.v; }
+inline bool operator<=(const Dual& a, const Dual& b) { return a.v <= b.v; }
+inline bool operator>=(const Dual& a, const Dual& b) { return a.v >= b.v; }
+
+// min and max pick one side, the gradient comes with it
+inline Dual min(const Dual& a, const Dual& b) { return a.v <= b.v ? a : b; }
+inline Dual max(const Dual& a, const Dual& b) { return a.v >= b.v ? a : b; }
+inline Dual abs(const Dual& a) { return a.v < 0 ? -a : a; }
+
+inline Dual sqrt(const Dual& a) {
+	float s = sqrtf(a.v);
+	return Dual(s, a.d * (0.5f / s));
+}
+inline Dual log(const Dual& a) { return Dual(logf(a.v), a.d / a.v); }
+inline Dual sin(const Dual& a) { return Dual(sinf(a.v), a.d * cosf(a.v)); }
+inline Dual cos(const Dual& a) { return Dual(cosf(a.v), a.d * -sinf(a.v)); }
+inline Dual acos(const Dual& a) { return Dual(acosf(a.v), a.d * (-1 / sqrtf(1 - a.v * a.v))); }
+inline Dual atan2(const Dual& y, const Dual& x) {
+	float r2 = x.v * x.v + y.v * y.v;
+	return Dual(atan2f(y.v, x.v), (y.d * x.v - x.d * y.v) / r2);
+}
+inline Dual pow(const Dual& a, float e) {
+	float p = powf(a.v, e);
+	return Dual(p, a.d * (e * p / a.v));
+}
+
+// floor has no slope, so mod keeps the gradient of a
+inline Dual mod(const Dual& a, float m) { return Dual(a.v - m * floorf(a.v / m), a.d); }
+
+
+// vector of duals, the counterpart of glm::vec3 in the sdf templates
+struct DualVec3 {
+	typedef Dual value_type;
+
+	DualVec3() {}
+	DualVec3(const Dual& x, const Dual& y, const Dual& z) : x(x), y(y), z(z) {}
+	DualVec3(const glm::vec3& c) : x(c.x), y(c.y), z(c.z) {}
+	explicit DualVec3(const Dual& s) : x(s), y(s), z(s) {}
+
+	// p as the variable the gradients are taken with respect to
+	static DualVec3 variable(const glm::vec3& p) {
+		return DualVec3(Dual(p.x, glm::vec3(1, 0, 0)), Dual(p.y, glm::vec3(0, 1, 0)), Dual(p.z, glm::vec3(0, 0, 1)));
+	}
+
+	Dual x, y, z;
+};
+
+inline DualVec3 operator+(const DualVec3& a, const DualVec3& b) { return DualVec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline DualVec3 operator-(const DualVec3& a, const DualVec3& b) { return DualVec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline DualVec3 operator+(const DualVec3& a, const Dual& s) { return DualVec3(a.x + s, a.y + s, a.z + s); }
+inline DualVec3 operator-(const DualVec3& a, const Dual& s) { return DualVec3(a.x - s, a.y - s, a.z - s); }
+inline DualVec3 operator-(const Dual& s, const DualVec3& a) { return DualVec3(s - a.x, s - a.y, s - a.z); }
+inline DualVec3 operator*(const DualVec3& a, const Dual& s) { return DualVec3(a.x * s, a.y * s, a.z * s); }
+inline DualVec3 operator*(const Dual& s, const DualVec3& a) { return a * s; }
+inline DualVec3 operator/(const DualVec3& a, const Dual& s) { return DualVec3(a.x / s, a.y / s, a.z / s); }
+inline DualVec3& operator+=(DualVec3& a, const DualVec3& b) { return a = a + b; }
+
+inline Dual dot(const DualVec3& a, const DualVec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Dual length(const DualVec3& a) { return sqrt(dot(a, a)); }
+inline DualVec3 abs(const DualVec3& a) { return DualVec3(abs(a.x), abs(a.y), abs(a.z)); }
+inline DualVec3 min(const DualVec3& a, const DualVec3& b) { return DualVec3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z)); }
+inline DualVec3 max(const DualVec3& a, const DualVec3& b) { return DualVec3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z)); }
+inline DualVec3 mod(const DualVec3& a, float m) { return DualVec3(mod(a.x, m), mod(a.y, m), mod(a.z, m)); }
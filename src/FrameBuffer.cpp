@@ -0,0 +1,39 @@
+#include "FrameBuffer.h"
+
+
+static const float softKnee = 0.8f;
+
+static inline float toneChannel(ToneOperator op, float v) {
+	switch (op) {
+	case TONE_SOFT:
+		// continuous with its slope at the knee, approaches 1
+		if (v > softKnee) v = softKnee + (1 - softKnee) * (1 - expf(-(v - softKnee) / (1 - softKnee)));
+		break;
+	case TONE_REINHARD:
+		v = v / (1 + v);
+		break;
+	default:
+		break;
+	}
+	return glm::clamp(v, 0.0f, 1.0f);
+}
+
+ofColor ToneMapping::apply(const glm::vec3& c) const {
+	glm::vec3 v = c * exposure;
+	return ofColor(toneChannel(op, v.r) * 255 + 0.5f, toneChannel(op, v.g) * 255 + 0.5f, toneChannel(op, v.b) * 255 + 0.5f);
+}
+
+bool ToneMapping::parse(const string& name, ToneOperator& op) {
+	if (name == "clamp") op = TONE_CLAMP;
+	else if (name == "soft") op = TONE_SOFT;
+	else if (name == "reinhard") op = TONE_REINHARD;
+	else return false;
+	return true;
+}
+
+void FrameBuffer::allocate(int width, int height) {
+	this->width = width;
+	this->height = height;
+	sum.assign((size_t)width * height, glm::vec3(0));
+	count.assign((size_t)width * height, 0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ofMain.h"
+#include <cstdint>
+
+
+enum ToneOperator {
+	TONE_CLAMP,             // clip at 1, what 8 bit shading used to do
+	TONE_SOFT,              // unchanged up to a knee, highlights roll off toward 1 above it
+	TONE_REINHARD           // c / (1 + c), compresses everything
+};
+
+// how linear colors (1 = the brightest 8 bit value) become display colors
+struct ToneMapping {
+	ofColor apply(const glm::vec3& c) const;
+	static bool parse(const string& name, ToneOperator& op);
+
+	ToneOperator op = TONE_CLAMP;
+	float exposure = 1;
+};
+
+
+//  float linear rgb image, every pixel sums up its samples
+//  samples are added across passes, get() averages whatever is there so far
+class FrameBuffer {
+public:
+	void allocate(int width, int height);       // no samples
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	// set() starts the pixel over with c as its only sample
+	void set(int x, int y, const glm::vec3& c) {
+		size_t i = (size_t)y * width + x;
+		sum[i] = c;
+		count[i] = 1;
+	}
+	void add(int x, int y, const glm::vec3& c) {
+		size_t i = (size_t)y * width + x;
+		sum[i] += c;
+		count[i]++;
+	}
+
+	int getSamples(int x, int y) const { return count[(size_t)y * width + x]; }
+	glm::vec3 get(int x, int y) const {
+		size_t i = (size_t)y * width + x;
+		return count[i] ? sum[i] / (float)count[i] : glm::vec3(0);
+	}
+
+private:
+	int width = 0, height = 0;
+	vector<glm::vec3> sum;
+	vector<uint16_t> count;
+};
@@ -0,0 +1,181 @@
+#include "MandelbulbDE.h"
+#include "PacketKernels.h"
+#include "SimdConfig.h"
+
+
+void mandelbulbDE8Scalar(const float* x, const float* y, const float* z, int iterations, int power, float bailout, float* dist) {
+	for (int k = 0; k < 8; k++) {
+		dist[k] = mandelbulbDEInteger(glm::vec3(x[k], y[k], z[k]), iterations, power, bailout);
+	}
+}
+
+void mandelbulbDE8(const float* x, const float* y, const float* z, int iterations, float power, float bailout, float* dist) {
+	int n = mandelbulbIntegerPower(power);
+	if (n == 0) {
+		for (int k = 0; k < 8; k++) {
+			dist[k] = sdfMandelbulb(glm::vec3(x[k], y[k], z[k]), iterations, power, bailout);
+		}
+		return;
+	}
+	PacketKernels::get().mandelbulb8(x, y, z, iterations, n, bailout, dist);
+}
+
+
+#ifdef PACKET_AVX2
+
+AVX2_TARGET static inline void complexSquare8(__m256& a, __m256& b) {
+	__m256 t = _mm256_sub_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+	b = _mm256_mul_ps(_mm256_add_ps(a, a), b);
+	a = t;
+}
+
+AVX2_TARGET static inline void complexPow8(__m256& a, __m256& b, int n) {
+	__m256 ra = _mm256_set1_ps(1);
+	__m256 rb = _mm256_setzero_ps();
+	while (n > 0) {
+		if (n & 1) {
+			__m256 t = _mm256_sub_ps(_mm256_mul_ps(ra, a), _mm256_mul_ps(rb, b));
+			rb = _mm256_add_ps(_mm256_mul_ps(ra, b), _mm256_mul_ps(rb, a));
+			ra = t;
+		}
+		complexSquare8(a, b);
+		n >>= 1;
+	}
+	a = ra;
+	b = rb;
+}
+
+AVX2_TARGET static inline __m256 powi8(__m256 x, int n) {
+	__m256 r = _mm256_set1_ps(1);
+	while (n > 0) {
+		if (n & 1) r = _mm256_mul_ps(r, x);
+		x = _mm256_mul_ps(x, x);
+		n >>= 1;
+	}
+	return r;
+}
+
+// same steps as mandelbulbDEInteger(), lanes that escaped keep their values
+AVX2_TARGET void mandelbulbDE8AVX2(const float* px, const float* py, const float* pz, int iterations, int power, float bailout, float* dist) {
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 n = _mm256_set1_ps((float)power);
+	const __m256 bail = _mm256_set1_ps(bailout);
+
+	__m256 cx = _mm256_loadu_ps(px);
+	__m256 cy = _mm256_loadu_ps(py);
+	__m256 cz = _mm256_loadu_ps(pz);
+	__m256 x = cx, y = cy, z = cz;
+	__m256 dr = one;
+	__m256 r = zero;
+	__m256 active = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+	for (int i = 0; i < iterations; i++) {
+		__m256 rho2 = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+		r = _mm256_blendv_ps(r, _mm256_sqrt_ps(_mm256_add_ps(rho2, _mm256_mul_ps(z, z))), active);
+		active = _mm256_and_ps(active, _mm256_cmp_ps(r, bail, _CMP_NGT_UQ));
+		if (_mm256_movemask_ps(active) == 0) break;
+
+		__m256 rho = _mm256_sqrt_ps(rho2);
+		__m256 rPositive = _mm256_cmp_ps(r, zero, _CMP_GT_OQ);
+		__m256 rhoPositive = _mm256_cmp_ps(rho, zero, _CMP_GT_OQ);
+		__m256 ta = _mm256_blendv_ps(one, _mm256_div_ps(z, r), rPositive);
+		__m256 tb = _mm256_blendv_ps(zero, _mm256_div_ps(rho, r), rPositive);
+		__m256 pa = _mm256_blendv_ps(one, _mm256_div_ps(x, rho), rhoPositive);
+		__m256 pb = _mm256_blendv_ps(zero, _mm256_div_ps(y, rho), rhoPositive);
+
+		__m256 rn1;
+		if (power == 8) {
+			for (int s = 0; s < 3; s++) {
+				complexSquare8(ta, tb);
+				complexSquare8(pa, pb);
+			}
+			__m256 r2 = _mm256_mul_ps(r, r);
+			rn1 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(r2, r2), r2), r);
+		}
+		else {
+			complexPow8(ta, tb, power);
+			complexPow8(pa, pb, power);
+			rn1 = powi8(r, power - 1);
+		}
+		dr = _mm256_blendv_ps(dr, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(rn1, n), dr), one), active);
+
+		__m256 rn = _mm256_mul_ps(rn1, r);
+		__m256 rnSin = _mm256_mul_ps(rn, tb);
+		x = _mm256_blendv_ps(x, _mm256_add_ps(_mm256_mul_ps(rnSin, pa), cx), active);
+		y = _mm256_blendv_ps(y, _mm256_add_ps(_mm256_mul_ps(rnSin, pb), cy), active);
+		z = _mm256_blendv_ps(z, _mm256_add_ps(_mm256_mul_ps(rn, ta), cz), active);
+	}
+
+	// no vector log, 8 scalar ones are cheap next to the iterations
+	float rs[8], drs[8];
+	_mm256_storeu_ps(rs, r);
+	_mm256_storeu_ps(drs, dr);
+	for (int k = 0; k < 8; k++) {
+		dist[k] = 0.5f * logf(rs[k]) * rs[k] / drs[k];
+	}
+}
+
+#endif
+
+
+// validation
+
+bool validateMandelbulbDE(int samples, unsigned int seed) {
+	const float tolerance = 1e-3f;
+	const float powers[] = { 2, 3, 4, 5, 7, 8, 9, 12, 16 };
+	const int iterationCounts[] = { 5, 10 };
+
+	MandelbulbKernel kernels[2] = { mandelbulbDE8Scalar, NULL };
+	const char* kernelNames[2] = { "scalar", "avx2" };
+#ifdef PACKET_AVX2
+	if (PacketKernels::cpuHasAVX2()) kernels[1] = mandelbulbDE8AVX2;
+#endif
+
+	PixelRandom rng;
+	rng.seed(seed, 0, 0);
+	bool ok = true;
+
+	printf("mandelbulb DE validation, %d points per case, error = |fast - reference| / max(|reference|, 1)\n", samples);
+	for (float power : powers) {
+		for (int iterations : iterationCounts) {
+			float maxError[2] = {};
+			int failed[2] = {};
+
+			for (int s = 0; s < samples; s += 8) {
+				float x[8], y[8], z[8], ref[8];
+				for (int k = 0; k < 8; k++) {
+					x[k] = rng.next(-1.5, 1.5);
+					y[k] = rng.next(-1.5, 1.5);
+					z[k] = rng.next(-1.5, 1.5);
+					ref[k] = sdfMandelbulb(glm::vec3(x[k], y[k], z[k]), iterations, power, 4);
+				}
+
+				for (int v = 0; v < 2; v++) {
+					if (!kernels[v]) continue;
+
+					float dist[8];
+					kernels[v](x, y, z, iterations, (int)power, 4, dist);
+					for (int k = 0; k < 8; k++) {
+						float error = fabsf(dist[k] - ref[k]) / glm::max(fabsf(ref[k]), 1.0f);
+						if (!(error <= tolerance)) failed[v]++;
+						if (error > maxError[v]) maxError[v] = error;
+					}
+				}
+			}
+
+			for (int v = 0; v < 2; v++) {
+				if (!kernels[v]) continue;
+
+				// a handful of points right on the fractal's boundary escape one iteration
+				// earlier or later in float, more than that is a bug
+				bool pass = failed[v] <= samples / 1000;
+				ok = ok && pass;
+				printf("  power %4.1f  iterations %2d  %-6s  max error %.2e  over %.0e: %d  %s\n", power, iterations,
+					kernelNames[v], maxError[v], tolerance, failed[v], pass ? "ok" : "FAILED");
+			}
+		}
+	}
+	if (!kernels[1]) printf("  (no avx2 on this cpu, only the scalar kernel was checked)\n");
+	return ok;
+}
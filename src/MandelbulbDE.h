@@ -0,0 +1,126 @@
+#pragma once
+
+#include "ofMain.h"
+#include "SDF.h"
+
+
+//  fast mandelbulb distance estimator
+//
+//  same estimate as sdfMandelbulb() in SDF.h, which stays as the reference. for
+//  integer powers the spherical power z^n is taken without any trigonometry: with
+//  rho = length(z.xy) the two angles become the unit complex numbers
+//    (z.z + i rho) / r   and   (z.x + i z.y) / rho
+//  and raising those to the n-th power rotates them by n times the angle. power 8,
+//  the classic bulb, is unrolled into three complex squarings. other powers use
+//  the trigonometric form
+//
+//  p is relative to the bulb's center. like the functions in SDF.h these are templates
+//  over the vector type, so DualVec3 gives the gradient along with the distance
+
+// power as an integer, 0 if it has a fraction (those take the trigonometric path)
+inline int mandelbulbIntegerPower(float power) {
+	return (power >= 1 && power <= 64 && power == floorf(power)) ? (int)power : 0;
+}
+
+// (a + bi)^n by repeated squaring
+template <class S>
+inline void complexPow(S& a, S& b, int n) {
+	S ra = 1.0f, rb = 0.0f;
+	while (n > 0) {
+		if (n & 1) {
+			S t = ra * a - rb * b;
+			rb = ra * b + rb * a;
+			ra = t;
+		}
+		S t = a * a - b * b;
+		b = S(2) * a * b;
+		a = t;
+		n >>= 1;
+	}
+	a = ra;
+	b = rb;
+}
+
+template <class S>
+inline S powi(S x, int n) {
+	S r = 1.0f;
+	while (n > 0) {
+		if (n & 1) r = r * x;
+		x = x * x;
+		n >>= 1;
+	}
+	return r;
+}
+
+template <class V, class S = typename V::value_type>
+S mandelbulbDEInteger(const V& p, int iterations, int n, float bailout) {
+	S x = p.x, y = p.y, z = p.z;
+	S dr = 1.0f;
+	S r = 0.0f;
+
+	for (int i = 0; i < iterations; i++) {
+		S rho2 = x * x + y * y;
+		r = sqrt(rho2 + z * z);
+		if (r > S(bailout)) break;
+
+		// cos theta + i sin theta and cos phi + i sin phi, no acos / atan2 needed
+		S rho = sqrt(rho2);
+		S ta = 1.0f, tb = 0.0f;
+		S pa = 1.0f, pb = 0.0f;
+		if (r > S(0)) {
+			ta = z / r;
+			tb = rho / r;
+		}
+		if (rho > S(0)) {
+			pa = x / rho;
+			pb = y / rho;
+		}
+
+		// multiply both angles by the power
+		S rn1;
+		if (n == 8) {
+			for (int s = 0; s < 3; s++) {
+				S t = ta * ta - tb * tb;
+				tb = S(2) * ta * tb;
+				ta = t;
+				t = pa * pa - pb * pb;
+				pb = S(2) * pa * pb;
+				pa = t;
+			}
+			S r2 = r * r;
+			rn1 = r2 * r2 * r2 * r;
+		}
+		else {
+			complexPow(ta, tb, n);
+			complexPow(pa, pb, n);
+			rn1 = powi(r, n - 1);
+		}
+		dr = rn1 * S((float)n) * dr + S(1);
+
+		// scale and rotate point
+		S rn = rn1 * r;
+		x = rn * tb * pa + p.x;
+		y = rn * tb * pb + p.y;
+		z = rn * ta + p.z;
+	}
+
+	return S(0.5f) * log(r) * r / dr;
+}
+
+template <class V, class S = typename V::value_type>
+inline S mandelbulbDE(const V& p, int iterations, float power, float bailout) {
+	int n = mandelbulbIntegerPower(power);
+	if (n == 0) return sdfMandelbulb(p, iterations, power, bailout);
+	return mandelbulbDEInteger(p, iterations, n, bailout);
+}
+
+// 8 points at once (avx2 when the cpu has it), x, y, z and dist hold 8 floats each
+void mandelbulbDE8(const float* x, const float* y, const float* z, int iterations, float power, float bailout, float* dist);
+
+// the PacketKernels entries behind mandelbulbDE8(), power must be a positive integer
+void mandelbulbDE8Scalar(const float* x, const float* y, const float* z, int iterations, int power, float bailout, float* dist);
+void mandelbulbDE8AVX2(const float* x, const float* y, const float* z, int iterations, int power, float bailout, float* dist);
+
+// compares the fast estimators against sdfMandelbulb() on random points for a
+// range of powers and prints the errors, false if any of them is off
+bool validateMandelbulbDE(int samples, unsigned int seed);
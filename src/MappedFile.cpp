@@ -0,0 +1,119 @@
+#include "MappedFile.h"
+#include <atomic>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (f == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(f);
+		return false;
+	}
+
+	HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m) {
+		CloseHandle(f);
+		return false;
+	}
+
+	void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+
+	file = f;
+	mapping = m;
+	bytes = (const unsigned char*)view;
+	length = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping) CloseHandle((HANDLE)mapping);
+	if (file) CloseHandle((HANDLE)file);
+	bytes = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	length = 0;
+}
+
+static unsigned long processId() { return GetCurrentProcessId(); }
+
+bool MappedFile::replace(const std::string& tempPath, const std::string& path) {
+	if (MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) return true;
+	DeleteFileA(tempPath.c_str());
+	return false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+	int f = ::open(path.c_str(), O_RDONLY);
+	if (f < 0) return false;
+
+	struct stat st;
+	if (fstat(f, &st) != 0 || st.st_size == 0) {
+		::close(f);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, f, 0);
+	if (view == MAP_FAILED) {
+		::close(f);
+		return false;
+	}
+
+	fd = f;
+	bytes = (const unsigned char*)view;
+	length = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) munmap((void*)bytes, length);
+	if (fd >= 0) ::close(fd);
+	bytes = nullptr;
+	length = 0;
+	fd = -1;
+}
+
+static unsigned long processId() { return (unsigned long)getpid(); }
+
+bool MappedFile::replace(const std::string& tempPath, const std::string& path) {
+	if (::rename(tempPath.c_str(), path.c_str()) == 0) return true;
+	::unlink(tempPath.c_str());
+	return false;
+}
+
+#endif
+
+
+// next to the file so the rename stays on one file system, unique per process and call
+std::string MappedFile::tempPath(const std::string& path) {
+	static std::atomic<unsigned> counter(0);
+	return path + ".tmp" + std::to_string(processId()) + "-" + std::to_string(counter++);
+}
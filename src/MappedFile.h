@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+//  read-only memory mapping of a whole file
+//  the mapping stays valid until close() or the object is destroyed, so anything
+//  pointing into data() must not outlive it
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return bytes != nullptr; }
+
+	// files that may be mapped are never rewritten in place, truncating one would crash
+	// whoever has it mapped. they are written to tempPath() and then replace()d, so
+	// readers see either the old complete file or the new one
+	static std::string tempPath(const std::string& path);
+	static bool replace(const std::string& tempPath, const std::string& path);
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
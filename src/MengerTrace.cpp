@@ -0,0 +1,98 @@
+#include "MengerTrace.h"
+
+
+// the ray in the sponge's unit cube, t is the same as along the world space ray
+struct MengerRay {
+	glm::vec3 o, d, invD;
+	float tMin;
+};
+
+// the cell at (x, y, z) of the 3 x 3 x 3 grid is hollow when two or more of them are 1
+static inline bool isSolid(const int* c) {
+	return (c[0] == 1) + (c[1] == 1) + (c[2] == 1) < 2;
+}
+
+// walk the ray through the 27 subcells of the solid cell at lo with edge s, which it
+// crosses from tEnter to tExit (entering through a face on axis)
+static bool traverseCell(const MengerRay& r, const glm::vec3& lo, float s, int depth,
+	float tEnter, float tExit, int axis, float& t, int& hitAxis) {
+
+	if (depth == 0) {
+		if (tEnter <= r.tMin) return false;
+		t = tEnter;
+		hitAxis = axis;
+		return true;
+	}
+
+	// subcell the ray starts in, clamped since it sits on the cell's boundary
+	float cs = s / 3;
+	glm::vec3 p = r.o + r.d * tEnter;
+	int c[3], step[3];
+	float tNext[3];
+	for (int a = 0; a < 3; a++) {
+		c[a] = glm::clamp((int)floorf((p[a] - lo[a]) / cs), 0, 2);
+		step[a] = r.d[a] > 0 ? 1 : -1;
+	}
+
+	float t0 = tEnter;
+	int enterAxis = axis;
+	for (;;) {
+		// where the ray leaves the subcell, from its planes so errors don't add up
+		for (int a = 0; a < 3; a++) {
+			tNext[a] = r.d[a] == 0 ? std::numeric_limits<float>::infinity()
+				: (lo[a] + (c[a] + (step[a] > 0)) * cs - r.o[a]) * r.invD[a];
+		}
+		int a = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+		float t1 = glm::min(tNext[a], tExit);
+
+		if (isSolid(c) && t0 < t1) {
+			glm::vec3 subLo(lo.x + c[0] * cs, lo.y + c[1] * cs, lo.z + c[2] * cs);
+			if (traverseCell(r, subLo, cs, depth - 1, t0, t1, enterAxis, t, hitAxis)) return true;
+		}
+
+		// step into the next subcell
+		if (tNext[a] >= tExit) return false;
+		c[a] += step[a];
+		if (c[a] < 0 || c[a] > 2) return false;
+		t0 = glm::max(t0, tNext[a]);
+		enterAxis = a;
+	}
+}
+
+bool intersectMenger(const Ray& ray, const glm::vec3& center, float size, int level, float tMax,
+	float& t, glm::vec3& normal) {
+
+	// into the unit cube, scaling the direction as well keeps t unchanged
+	MengerRay r;
+	r.o = (ray.p - center) / size + glm::vec3(0.5);
+	r.d = ray.d / size;
+	r.invD = 1.0f / r.d;
+	r.tMin = mengerMinHitDistance;
+
+	// where the ray crosses the outer cube, the entry axis gives the face normal
+	float tNear = 0;
+	float tFar = tMax;
+	int axis = -1;
+	for (int a = 0; a < 3; a++) {
+		if (r.d[a] == 0) {
+			if (r.o[a] < 0 || r.o[a] > 1) return false;
+			continue;
+		}
+		float t0 = -r.o[a] * r.invD[a];
+		float t1 = (1 - r.o[a]) * r.invD[a];
+		if (t0 > t1) std::swap(t0, t1);
+		if (t0 > tNear) {
+			tNear = t0;
+			axis = a;
+		}
+		tFar = glm::min(tFar, t1);
+	}
+	if (!(tNear < tFar)) return false;
+
+	int hitAxis;
+	if (!traverseCell(r, glm::vec3(0), 1, glm::max(level, 0), tNear, tFar, axis, t, hitAxis)) return false;
+
+	normal = glm::vec3(0);
+	normal[hitAxis] = ray.d[hitAxis] > 0 ? -1.0f : 1.0f;
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Primitives.h"
+
+
+//  exact ray / menger sponge intersection
+//
+//  walks the 3 x 3 x 3 subdivision of the cube with a dda: the cells the ray passes
+//  through are visited in order, the 7 hollow ones are skipped and the 20 solid ones
+//  are descended into until level reaches 0, where the cell is solid and the face
+//  the ray entered it through is the hit. same sponge as sdfMenger() in SDF.h
+//
+//  center and size give the outer cube, only hits with t < tMax are reported.
+//  solid cells entered closer than mengerMinHitDistance are passed through,
+//  so rays leaving the surface don't hit it again
+
+static const float mengerMinHitDistance = 1e-4;
+
+bool intersectMenger(const Ray& ray, const glm::vec3& center, float size, int level, float tMax,
+	float& t, glm::vec3& normal);
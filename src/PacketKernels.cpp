@@ -0,0 +1,339 @@
+#include "PacketKernels.h"
+
+#include "MandelbulbDE.h"
+#include "SimdConfig.h"
+
+// directions closer to parallel than this never hit a plane
+static const float parallelEps = 1e-7f;
+
+
+// ray packet
+
+void RayPacket::add(const Ray& ray, float maxDist) {
+	int k = count++;
+	ox[k] = ray.p.x;
+	oy[k] = ray.p.y;
+	oz[k] = ray.p.z;
+	dx[k] = ray.d.x;
+	dy[k] = ray.d.y;
+	dz[k] = ray.d.z;
+	ix[k] = 1.0f / ray.d.x;
+	iy[k] = 1.0f / ray.d.y;
+	iz[k] = 1.0f / ray.d.z;
+	tMax[k] = maxDist;
+	hit[k] = -1;
+}
+
+void RayPacket::pad() {
+	for (int k = count; k < width; k++) {
+		ox[k] = oy[k] = oz[k] = 0;
+		dx[k] = dy[k] = 0;
+		dz[k] = 1;
+		ix[k] = iy[k] = iz[k] = 1;
+		tMax[k] = -1;
+		hit[k] = -1;
+	}
+}
+
+bool RayPacket::hitsBox(const AABB& box) const {
+	for (int k = 0; k < count; k++) {
+		if (!(tMax[k] > 0)) continue;
+
+		float tNear;
+		if (box.intersect(glm::vec3(ox[k], oy[k], oz[k]), glm::vec3(ix[k], iy[k], iz[k]), tMax[k], tNear)) return true;
+	}
+	return false;
+}
+
+
+// scalar kernels, the reference the simd versions have to match
+
+static int intersectSphereScalar(RayPacket& packet, const glm::vec3& center, float radius, int id) {
+	int mask = 0;
+	for (int k = 0; k < RayPacket::width; k++) {
+		float ocx = packet.ox[k] - center.x;
+		float ocy = packet.oy[k] - center.y;
+		float ocz = packet.oz[k] - center.z;
+		float b = ocx * packet.dx[k] + ocy * packet.dy[k] + ocz * packet.dz[k];
+		float c = ocx * ocx + ocy * ocy + ocz * ocz - radius * radius;
+		float disc = b * b - c;
+		if (disc < 0) continue;
+
+		// entry point, or the exit point if the ray starts inside the sphere
+		float root = sqrtf(disc);
+		float t = -b - root;
+		if (t <= 0) t = -b + root;
+		if (t > 0 && t < packet.tMax[k]) {
+			packet.tMax[k] = t;
+			packet.hit[k] = id;
+			mask |= 1 << k;
+		}
+	}
+	return mask;
+}
+
+static int intersectPlaneScalar(RayPacket& packet, const AxisPlane& plane, int id) {
+	if (plane.axis < 0) return 0;
+
+	const float* oa = packet.origin(plane.axis);
+	const float* da = packet.dir(plane.axis);
+	const float* ou = packet.origin((plane.axis + 1) % 3);
+	const float* du = packet.dir((plane.axis + 1) % 3);
+	const float* ov = packet.origin((plane.axis + 2) % 3);
+	const float* dv = packet.dir((plane.axis + 2) % 3);
+
+	int mask = 0;
+	for (int k = 0; k < RayPacket::width; k++) {
+		if (fabsf(da[k]) < parallelEps) continue;
+
+		float t = (plane.offset - oa[k]) / da[k];
+		if (!(t > 0 && t < packet.tMax[k])) continue;
+
+		float pu = ou[k] + t * du[k];
+		float pv = ov[k] + t * dv[k];
+		if (pu > plane.lo.x && pu < plane.hi.x && pv > plane.lo.y && pv < plane.hi.y) {
+			packet.tMax[k] = t;
+			packet.hit[k] = id;
+			mask |= 1 << k;
+		}
+	}
+	return mask;
+}
+
+
+// sse kernels, two groups of 4 lanes
+
+#ifdef PACKET_SSE
+
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// write t and id into the lanes of mask, returns the lanes as bits
+static inline int update4(RayPacket& packet, int base, __m128 mask, __m128 t, __m128 tMax, int id) {
+	int bits = _mm_movemask_ps(mask);
+	if (bits) {
+		_mm_storeu_ps(packet.tMax + base, select4(mask, t, tMax));
+		__m128 ids = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(packet.hit + base)));
+		ids = select4(mask, _mm_castsi128_ps(_mm_set1_epi32(id)), ids);
+		_mm_storeu_si128((__m128i*)(packet.hit + base), _mm_castps_si128(ids));
+	}
+	return bits << base;
+}
+
+static int intersectSphereSSE(RayPacket& packet, const glm::vec3& center, float radius, int id) {
+	const __m128 cx = _mm_set1_ps(center.x);
+	const __m128 cy = _mm_set1_ps(center.y);
+	const __m128 cz = _mm_set1_ps(center.z);
+	const __m128 r2 = _mm_set1_ps(radius * radius);
+	const __m128 zero = _mm_setzero_ps();
+
+	int mask = 0;
+	for (int base = 0; base < RayPacket::width; base += 4) {
+		__m128 ocx = _mm_sub_ps(_mm_loadu_ps(packet.ox + base), cx);
+		__m128 ocy = _mm_sub_ps(_mm_loadu_ps(packet.oy + base), cy);
+		__m128 ocz = _mm_sub_ps(_mm_loadu_ps(packet.oz + base), cz);
+		__m128 dx = _mm_loadu_ps(packet.dx + base);
+		__m128 dy = _mm_loadu_ps(packet.dy + base);
+		__m128 dz = _mm_loadu_ps(packet.dz + base);
+
+		__m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+		__m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)), r2);
+		__m128 disc = _mm_sub_ps(_mm_mul_ps(b, b), c);
+		__m128 valid = _mm_cmpge_ps(disc, zero);
+
+		__m128 root = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+		__m128 nb = _mm_sub_ps(zero, b);
+		__m128 t0 = _mm_sub_ps(nb, root);
+		__m128 t1 = _mm_add_ps(nb, root);
+		__m128 t = select4(_mm_cmple_ps(t0, zero), t1, t0);
+
+		__m128 tMax = _mm_loadu_ps(packet.tMax + base);
+		__m128 hit = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, tMax)));
+		mask |= update4(packet, base, hit, t, tMax, id);
+	}
+	return mask;
+}
+
+static int intersectPlaneSSE(RayPacket& packet, const AxisPlane& plane, int id) {
+	if (plane.axis < 0) return 0;
+
+	const float* oa = packet.origin(plane.axis);
+	const float* da = packet.dir(plane.axis);
+	const float* ou = packet.origin((plane.axis + 1) % 3);
+	const float* du = packet.dir((plane.axis + 1) % 3);
+	const float* ov = packet.origin((plane.axis + 2) % 3);
+	const float* dv = packet.dir((plane.axis + 2) % 3);
+
+	const __m128 offset = _mm_set1_ps(plane.offset);
+	const __m128 loU = _mm_set1_ps(plane.lo.x);
+	const __m128 hiU = _mm_set1_ps(plane.hi.x);
+	const __m128 loV = _mm_set1_ps(plane.lo.y);
+	const __m128 hiV = _mm_set1_ps(plane.hi.y);
+	const __m128 eps = _mm_set1_ps(parallelEps);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 zero = _mm_setzero_ps();
+
+	int mask = 0;
+	for (int base = 0; base < RayPacket::width; base += 4) {
+		__m128 d = _mm_loadu_ps(da + base);
+		__m128 facing = _mm_cmpge_ps(_mm_and_ps(d, absMask), eps);
+		__m128 t = _mm_div_ps(_mm_sub_ps(offset, _mm_loadu_ps(oa + base)), d);
+
+		__m128 pu = _mm_add_ps(_mm_loadu_ps(ou + base), _mm_mul_ps(t, _mm_loadu_ps(du + base)));
+		__m128 pv = _mm_add_ps(_mm_loadu_ps(ov + base), _mm_mul_ps(t, _mm_loadu_ps(dv + base)));
+		__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(pu, loU), _mm_cmplt_ps(pu, hiU)),
+			_mm_and_ps(_mm_cmpgt_ps(pv, loV), _mm_cmplt_ps(pv, hiV)));
+
+		__m128 tMax = _mm_loadu_ps(packet.tMax + base);
+		__m128 hit = _mm_and_ps(_mm_and_ps(facing, inside), _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, tMax)));
+		mask |= update4(packet, base, hit, t, tMax, id);
+	}
+	return mask;
+}
+
+#endif
+
+
+// avx2 kernels, all 8 lanes at once
+
+#ifdef PACKET_AVX2
+
+AVX2_TARGET static inline int update8(RayPacket& packet, __m256 mask, __m256 t, __m256 tMax, int id) {
+	int bits = _mm256_movemask_ps(mask);
+	if (bits) {
+		_mm256_storeu_ps(packet.tMax, _mm256_blendv_ps(tMax, t, mask));
+		__m256i ids = _mm256_loadu_si256((const __m256i*)packet.hit);
+		ids = _mm256_blendv_epi8(ids, _mm256_set1_epi32(id), _mm256_castps_si256(mask));
+		_mm256_storeu_si256((__m256i*)packet.hit, ids);
+	}
+	return bits;
+}
+
+AVX2_TARGET static int intersectSphereAVX2(RayPacket& packet, const glm::vec3& center, float radius, int id) {
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 ocx = _mm256_sub_ps(_mm256_loadu_ps(packet.ox), _mm256_set1_ps(center.x));
+	__m256 ocy = _mm256_sub_ps(_mm256_loadu_ps(packet.oy), _mm256_set1_ps(center.y));
+	__m256 ocz = _mm256_sub_ps(_mm256_loadu_ps(packet.oz), _mm256_set1_ps(center.z));
+	__m256 dx = _mm256_loadu_ps(packet.dx);
+	__m256 dy = _mm256_loadu_ps(packet.dy);
+	__m256 dz = _mm256_loadu_ps(packet.dz);
+
+	__m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+	__m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)),
+		_mm256_mul_ps(ocz, ocz)), _mm256_set1_ps(radius * radius));
+	__m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), c);
+	__m256 valid = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+
+	__m256 root = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+	__m256 nb = _mm256_sub_ps(zero, b);
+	__m256 t0 = _mm256_sub_ps(nb, root);
+	__m256 t1 = _mm256_add_ps(nb, root);
+	__m256 t = _mm256_blendv_ps(t0, t1, _mm256_cmp_ps(t0, zero, _CMP_LE_OQ));
+
+	__m256 tMax = _mm256_loadu_ps(packet.tMax);
+	__m256 hit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, tMax, _CMP_LT_OQ)));
+	return update8(packet, hit, t, tMax, id);
+}
+
+AVX2_TARGET static int intersectPlaneAVX2(RayPacket& packet, const AxisPlane& plane, int id) {
+	if (plane.axis < 0) return 0;
+
+	const float* oa = packet.origin(plane.axis);
+	const float* da = packet.dir(plane.axis);
+	const float* ou = packet.origin((plane.axis + 1) % 3);
+	const float* du = packet.dir((plane.axis + 1) % 3);
+	const float* ov = packet.origin((plane.axis + 2) % 3);
+	const float* dv = packet.dir((plane.axis + 2) % 3);
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	__m256 d = _mm256_loadu_ps(da);
+	__m256 facing = _mm256_cmp_ps(_mm256_and_ps(d, absMask), _mm256_set1_ps(parallelEps), _CMP_GE_OQ);
+	__m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_set1_ps(plane.offset), _mm256_loadu_ps(oa)), d);
+
+	__m256 pu = _mm256_add_ps(_mm256_loadu_ps(ou), _mm256_mul_ps(t, _mm256_loadu_ps(du)));
+	__m256 pv = _mm256_add_ps(_mm256_loadu_ps(ov), _mm256_mul_ps(t, _mm256_loadu_ps(dv)));
+	__m256 inside = _mm256_and_ps(
+		_mm256_and_ps(_mm256_cmp_ps(pu, _mm256_set1_ps(plane.lo.x), _CMP_GT_OQ), _mm256_cmp_ps(pu, _mm256_set1_ps(plane.hi.x), _CMP_LT_OQ)),
+		_mm256_and_ps(_mm256_cmp_ps(pv, _mm256_set1_ps(plane.lo.y), _CMP_GT_OQ), _mm256_cmp_ps(pv, _mm256_set1_ps(plane.hi.y), _CMP_LT_OQ)));
+
+	__m256 tMax = _mm256_loadu_ps(packet.tMax);
+	__m256 hit = _mm256_and_ps(_mm256_and_ps(facing, inside),
+		_mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, tMax, _CMP_LT_OQ)));
+	return update8(packet, hit, t, tMax, id);
+}
+
+#endif
+
+
+// avx2 needs the cpu to have it and the os to save the ymm registers
+bool PacketKernels::cpuHasAVX2() {
+#ifdef PACKET_AVX2
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+#else
+	return false;
+#endif
+}
+
+
+// dispatch
+
+static const PacketKernels scalarKernels = { "scalar", intersectSphereScalar, intersectPlaneScalar, mandelbulbDE8Scalar };
+#ifdef PACKET_SSE
+static const PacketKernels sseKernels = { "sse", intersectSphereSSE, intersectPlaneSSE, mandelbulbDE8Scalar };
+#endif
+#ifdef PACKET_AVX2
+static const PacketKernels avx2Kernels = { "avx2", intersectSphereAVX2, intersectPlaneAVX2, mandelbulbDE8AVX2 };
+#endif
+
+static const PacketKernels* bestKernels() {
+#ifdef PACKET_AVX2
+	if (PacketKernels::cpuHasAVX2()) return &avx2Kernels;
+#endif
+#ifdef PACKET_SSE
+	return &sseKernels;
+#endif
+	return &scalarKernels;
+}
+
+static const PacketKernels*& activeKernels() {
+	static const PacketKernels* active = bestKernels();
+	return active;
+}
+
+const PacketKernels& PacketKernels::get() {
+	return *activeKernels();
+}
+
+bool PacketKernels::select(const string& isa) {
+	const PacketKernels* kernels = NULL;
+	if (isa == "scalar") kernels = &scalarKernels;
+#ifdef PACKET_SSE
+	if (isa == "sse") kernels = &sseKernels;
+#endif
+#ifdef PACKET_AVX2
+	if (isa == "avx2" && cpuHasAVX2()) kernels = &avx2Kernels;
+#endif
+	if (!kernels) return false;
+
+	activeKernels() = kernels;
+	return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Primitives.h"
+
+
+//  up to 8 rays stored as structure of arrays for the simd intersection kernels
+//  lanes with tMax <= 0 are done (padding, or a shadow ray that is already blocked)
+struct alignas(32) RayPacket {
+	static const int width = 8;
+
+	void clear() { count = 0; }
+	void add(const Ray& ray, float maxDist);
+	void pad();     // fill the unused lanes so they never hit anything
+
+	Ray getRay(int lane) const {
+		return Ray(glm::vec3(ox[lane], oy[lane], oz[lane]), glm::vec3(dx[lane], dy[lane], dz[lane]));
+	}
+	const float* origin(int axis) const { return axis == 0 ? ox : axis == 1 ? oy : oz; }
+	const float* dir(int axis) const { return axis == 0 ? dx : axis == 1 ? dy : dz; }
+
+	// any live lane hits the box before its tMax
+	bool hitsBox(const AABB& box) const;
+
+	float ox[width], oy[width], oz[width];
+	float dx[width], dy[width], dz[width];
+	float ix[width], iy[width], iz[width];      // 1 / direction, for the box tests
+	float tMax[width];      // closest hit so far, or how far a shadow ray may go
+	int hit[width];         // id of the closest hit, -1 = none
+	int count = 0;          // lanes in use
+};
+
+
+//  packet intersection kernels: each tests one primitive against every lane of a
+//  packet. lanes where it is hit closer than tMax get tMax = t and hit = id, the
+//  returned bit mask has a bit set for each of those lanes
+typedef int (*SphereKernel)(RayPacket& packet, const glm::vec3& center, float radius, int id);
+typedef int (*PlaneKernel)(RayPacket& packet, const AxisPlane& plane, int id);
+
+// mandelbulb distance estimate for 8 points with an integer power, see MandelbulbDE.h
+typedef void (*MandelbulbKernel)(const float* x, const float* y, const float* z, int iterations, int power, float bailout, float* dist);
+
+struct PacketKernels {
+	const char* name;
+	SphereKernel intersectSphere;
+	PlaneKernel intersectPlane;
+	MandelbulbKernel mandelbulb8;
+
+	// fastest kernels the cpu supports, picked the first time they are needed
+	static const PacketKernels& get();
+
+	// force "scalar", "sse" or "avx2" (to compare them), false if this cpu can't run them
+	static bool select(const string& isa);
+
+	// the cpu has avx2 and the os saves the ymm registers
+	static bool cpuHasAVX2();
+};
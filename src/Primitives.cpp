@@ -1,4 +1,9 @@
 #include "Primitives.h"
+#include "MengerTrace.h"
+#include "Sampler.h"
+
+
+bool SceneObject::bHeadless = false;
 
 
 int PointLight::ext = 0;
@@ -31,14 +36,14 @@ void PointLight::draw() {
 	ofDrawSphere(position, 0.2);
 }
 
-int PointLight::getRaySamples(glm::vec3 p, glm::vec3 norm) {
+int PointLight::getSamples(const glm::vec3& p, LightSample* samples, int maxSamples, Sampler& sampler) const {
 	// a point light only ever has one light ray at a time
-	samples.clear();
+	if (maxSamples < 1) return 0;
 
-	Ray r = Ray(p + norm * 0.01f, glm::normalize(position - p));
-	samples.push_back(r);
-	samplesPos.push_back(position);
-	return samples.size();
+	samples[0].pos = position;
+	samples[0].dist = glm::length(position - p);
+	samples[0].dir = (position - p) / samples[0].dist;
+	return 1;
 }
 
 int AreaLight::ext = 0;
@@ -126,41 +131,23 @@ bool AreaLight::intersect(const Ray& ray, glm::vec3& point, glm::vec3& normalAtI
 	return insidePlane;
 }
 
-int AreaLight::getRaySamples(glm::vec3 p, glm::vec3 norm) {
-	samples.clear();
-	samplesPos.clear();
-
-	// grid dimensions relative to origin point (center)
-	float leftX = -width / 2;
-	float rightX = width / 2;
-	float topZ = -height / 2;
-	float botZ = height / 2;
+int AreaLight::getSamples(const glm::vec3& p, LightSample* samples, int maxSamples, Sampler& sampler) const {
+	int count = glm::min(getSampleCount(), maxSamples);
 
-	// size & width of each cell
-	float cellWidth = width / nDivsWidth;
-	float cellHeight = height / nDivsHeight;
+	// nSamples points per cell of the grid when stratified, the other samplers spread
+	// them over the whole light
+	sampler.begin(count, nDivsWidth, nDivsHeight);
+	for (int k = 0; k < count; k++) {
+		glm::vec2 u = sampler.next();
 
-	// for each cell in the grid, get nSamples random rays
-	for (int i = 0; i < nDivsWidth; i++) {
-		for (int j = 0; j < nDivsHeight; j++) {
-
-			// get dimensions of cell
-			float cellLeftX = leftX + (i * cellWidth);
-			float cellRightX = leftX + (i * cellWidth) + cellWidth;
-			float cellTopZ = topZ + (j * cellHeight);
-			float cellBotZ = topZ + (j * cellHeight) + cellHeight;
-
-			// get randomized point in cell as ray
-			for (int s = 0; s < nSamples; s++) {
-				glm::vec3 samplePos = glm::vec3(ofRandom(cellLeftX, cellRightX), 0, ofRandom(cellTopZ, cellBotZ)) + position;
-				Ray r = Ray(p + norm * 0.01f, glm::normalize(samplePos - p));
-				samples.push_back(r);
-				samplesPos.push_back(samplePos);
-			}
-		}
+		// grid is centered on its position
+		LightSample& sample = samples[k];
+		sample.pos = position + glm::vec3((u.x - 0.5f) * width, 0, (u.y - 0.5f) * height);
+		sample.dist = glm::length(sample.pos - p);
+		sample.dir = (sample.pos - p) / sample.dist;
 	}
 
-	return samples.size();
+	return count;
 }
 
 
@@ -194,6 +181,30 @@ void Sphere::draw() {
 	ofDrawSphere(position, radius);
 }
 
+bool Sphere::intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) {
+	float t;
+	if (!hitDistance(ray, t)) return false;
+
+	point = ray.p + t * ray.d;
+	normal = glm::normalize(point - position);
+	return true;
+}
+
+// distance along the ray to the sphere (same math as the packet kernels)
+bool Sphere::hitDistance(const Ray& ray, float& t) {
+	glm::vec3 oc = ray.p - position;
+	float b = glm::dot(oc, ray.d);
+	float c = glm::dot(oc, oc) - radius * radius;
+	float disc = b * b - c;
+	if (disc < 0) return false;
+
+	// entry point, or the exit point if the ray starts inside the sphere
+	float root = sqrt(disc);
+	t = -b - root;
+	if (t <= 0) t = -b + root;
+	return t > 0;
+}
+
 // get texture coordinates from point on sphere
 void Sphere::getTextureCoords(glm::vec3 p, float& u, float& v) {
 
@@ -249,47 +260,60 @@ void Plane::draw() {
 	plane.draw();
 }
 
-// Intersect Ray with Plane  (wrapper on glm::intersect*)
+// Intersect Ray with Plane  (the rectangle test lives in AxisPlane)
 bool Plane::intersect(const Ray& ray, glm::vec3& point, glm::vec3& normalAtIntersect) {
 	float dist;
-	bool insidePlane = false;
-	bool hit = glm::intersectRayPlane(ray.p, ray.d, position, this->normal, dist);
-	if (hit) {
-		Ray r = ray;
-		point = r.evalPoint(dist);
-		normalAtIntersect = this->normal;
-		
-		glm::vec2 xrange = glm::vec2(position.x - width / 2, position.x + width
-			/ 2);
-		glm::vec2 yrange = glm::vec2(position.y - width / 2, position.y + width
-			/ 2);
-		glm::vec2 zrange = glm::vec2(position.z - height / 2, position.z +
-			height / 2);
-		// horizontal
-		if (normal == glm::vec3(0, 1, 0) || normal == glm::vec3(0, -1, 0)) {
-			if (point.x < xrange[1] && point.x > xrange[0] && point.z <
-				zrange[1] && point.z > zrange[0]) {
-				insidePlane = true;
-			}
-		}
-		// front or back
-		else if (normal == glm::vec3(0, 0, 1) || normal == glm::vec3(0, 0, -1))
-		{
-			if (point.x < xrange[1] && point.x > xrange[0] && point.y <
-				yrange[1] && point.y > yrange[0]) {
-				insidePlane = true;
-			}
-		}
-		// left or right
-		else if (normal == glm::vec3(1, 0, 0) || normal == glm::vec3(-1, 0, 0))
-		{
-			if (point.y < yrange[1] && point.y > yrange[0] && point.z <
-				zrange[1] && point.z > zrange[0]) {
-				insidePlane = true;
-			}
-		}
-	}
-	return insidePlane;
+	if (!hitDistance(ray, dist)) return false;
+
+	Ray r = ray;
+	point = r.evalPoint(dist);
+	normalAtIntersect = this->normal;
+	return true;
+}
+
+void Plane::setNormal(glm::vec3 n) {
+	normal = n;
+	axis = AxisPlane::axisOf(n);    // intersect() never hits planes that aren't axis aligned
+}
+
+// same rotation as the constructor, the primitive faces (0, 0, 1) before it
+glm::vec3 Plane::upDirOf(const glm::vec3& n) {
+	glm::quat q = n.z != -1 ? glm::angleAxis(glm::radians(90.0f), glm::vec3(-n.y, abs(n.x), 0))
+		: glm::angleAxis(glm::radians(180.0f), glm::vec3(1, 0, 0));
+	return q * glm::vec3(0, 1, 0);
+}
+
+int AxisPlane::axisOf(const glm::vec3& n) {
+	if (n == glm::vec3(1, 0, 0) || n == glm::vec3(-1, 0, 0)) return 0;
+	if (n == glm::vec3(0, 1, 0) || n == glm::vec3(0, -1, 0)) return 1;
+	if (n == glm::vec3(0, 0, 1) || n == glm::vec3(0, 0, -1)) return 2;
+	return -1;
+}
+
+// half size of the rectangle along x, y, z
+static glm::vec3 planeHalfSize(int axis, float width, float height) {
+	if (axis == 0) return glm::vec3(0, width / 2, height / 2);	// left or right
+	if (axis == 1) return glm::vec3(width / 2, 0, height / 2);	// horizontal
+	return glm::vec3(width / 2, width / 2, 0);						// front or back
+}
+
+AxisPlane AxisPlane::fromRect(const glm::vec3& position, const glm::vec3& normal, float width, float height) {
+	AxisPlane r;
+	int axis = axisOf(normal);
+	if (axis < 0) return r;
+
+	int u = (axis + 1) % 3;
+	int v = (axis + 2) % 3;
+	glm::vec3 half = planeHalfSize(axis, width, height);
+	r.axis = axis;
+	r.offset = position[axis];
+	r.lo = glm::vec2(position[u] - half[u], position[v] - half[v]);
+	r.hi = glm::vec2(position[u] + half[u], position[v] + half[v]);
+	return r;
+}
+
+AxisPlane Plane::getAxisPlane() {
+	return AxisPlane::fromRect(position, normal, width, height);
 }
 
 // get texture coordinates from point on plane
@@ -313,7 +337,7 @@ void Plane::upNormal(bool& val) {
 	if (faceUp) {
 		// reset plane and rotate to normal
 		plane = ofPlanePrimitive();
-		normal = glm::vec3(0, 1, 0);
+		setNormal(glm::vec3(0, 1, 0));
 		plane.rotateDeg(-90, 1, 0, 0);
 
 		faceDown = false;
@@ -327,7 +351,7 @@ void Plane::downNormal(bool& val) {
 	if (faceDown) {
 		// reset plane and rotate to normal
 		plane = ofPlanePrimitive();
-		normal = glm::vec3(0, -1, 0);
+		setNormal(glm::vec3(0, -1, 0));
 		plane.rotateDeg(90, 1, 0, 0);
 
 		faceUp = false;
@@ -341,7 +365,7 @@ void Plane::leftNormal(bool& val) {
 	if (faceLeft) {
 		// reset plane and rotate to normal
 		plane = ofPlanePrimitive();
-		normal = glm::vec3(-1, 0, 0);
+		setNormal(glm::vec3(-1, 0, 0));
 		plane.rotateDeg(-90, 0, 1, 0);
 
 		faceUp = false;
@@ -355,7 +379,7 @@ void Plane::rightNormal(bool& val) {
 	if (faceRight) {
 		// reset plane and rotate to normal
 		plane = ofPlanePrimitive();
-		normal = glm::vec3(1, 0, 0);
+		setNormal(glm::vec3(1, 0, 0));
 		plane.rotateDeg(90, 0, 1, 0);
 
 		faceUp = false;
@@ -369,7 +393,7 @@ void Plane::forwardNormal(bool& val) {
 	if (faceForward) {
 		// by default plane faces (0, 0, 1)
 		plane = ofPlanePrimitive();
-		normal = glm::vec3(0, 0, 1);
+		setNormal(glm::vec3(0, 0, 1));
 
 		faceUp = false;
 		faceDown = false;
@@ -382,7 +406,7 @@ void Plane::backwardNormal(bool& val) {
 	if (faceBackward) {
 		// reset plane and rotate to normal
 		plane = ofPlanePrimitive();
-		normal = glm::vec3(0, 0, -1);
+		setNormal(glm::vec3(0, 0, -1));
 		plane.rotateDeg(180, 1, 0, 0);
 
 		faceUp = false;
@@ -436,24 +460,11 @@ void MengerSponge::draw() {
 }
 
 bool MengerSponge::intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) {
-	bool hit = false;
-	float closestDist = std::numeric_limits<float>::infinity();
-	glm::vec3 p, n;
-
-	for (Plane* f : faces) {
-		if (f->intersect(ray, p, n)) {
-			hit = true;
-
-			// compare faces to find closest point
-			float dist = distance(ray.p, p);
-			if (dist < closestDist) {
-				point = p;
-				normal = n;
-			}
-		}
-	}
+	float t;
+	if (!intersectMenger(ray, position, dimensions.x, level, std::numeric_limits<float>::infinity(), t, normal)) return false;
 
-	return hit;
+	point = ray.p + t * ray.d;
+	return true;
 }
 
 
@@ -5,6 +5,8 @@
 #include "glm/gtx/euler_angles.hpp"
 #include "glm/gtx/intersect.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include "SDF.h"
+#include "TextureMap.h"
 
 
 //  General Purpose Ray class 
@@ -21,19 +23,164 @@ public:
 };
 
 
+//  axis aligned bounding box
+class AABB {
+public:
+	AABB() {}
+	AABB(glm::vec3 min, glm::vec3 max) { this->min = min; this->max = max; }
+
+	void grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+	void grow(const AABB& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+	bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+
+	// half the surface area, all the surface area heuristic needs
+	float area() const {
+		if (isEmpty()) return 0;
+		glm::vec3 e = max - min;
+		return e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+
+	// slab test, tNear is where the ray enters the box
+	bool intersect(const glm::vec3& origin, const glm::vec3& invDir, float tMax, float& tNear) const {
+		glm::vec3 t0 = (min - origin) * invDir;
+		glm::vec3 t1 = (max - origin) * invDir;
+		glm::vec3 tSmall = glm::min(t0, t1);
+		glm::vec3 tBig = glm::max(t0, t1);
+		tNear = glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f));
+		float tFar = glm::min(glm::min(tBig.x, tBig.y), glm::min(tBig.z, tMax));
+		return tNear <= tFar;
+	}
+
+	// distance from p to the box, 0 inside
+	float distance(const glm::vec3& p) const {
+		glm::vec3 d = glm::max(min - p, p - max);
+		return glm::length(glm::max(d, glm::vec3(0)));
+	}
+
+	glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+};
+
+
+//  rectangle in an axis aligned plane, the form Plane::intersect() and the packet
+//  kernels work with
+struct AxisPlane {
+	int axis = -1;          // axis of the normal: 0 = x, 1 = y, 2 = z, -1 = not axis aligned
+	float offset = 0;       // position of the plane along axis
+	glm::vec2 lo, hi;       // open range on the other two axes, (axis + 1) % 3 and (axis + 2) % 3
+
+	// axis of a plane normal, -1 if it isn't axis aligned
+	static int axisOf(const glm::vec3& n);
+
+	// rectangle of a plane with the given center, normal and size
+	static AxisPlane fromRect(const glm::vec3& position, const glm::vec3& normal, float width, float height);
+
+	// distance along the ray to the rectangle, hit from either side
+	bool intersect(const glm::vec3& o, const glm::vec3& d, float& t) const {
+		if (axis < 0 || glm::abs(d[axis]) < 1e-7f) return false;
+		t = (offset - o[axis]) / d[axis];
+		if (!(t > 0)) return false;
+
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		float pu = o[u] + t * d[u];
+		float pv = o[v] + t * d[v];
+		return pu > lo.x && pu < hi.x && pv > lo.y && pv < hi.y;
+	}
+
+	// box around the rectangle, with a little thickness so rays don't slip past it
+	AABB getBounds() const {
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		glm::vec3 min, max;
+		min[axis] = offset - 0.001f;
+		max[axis] = offset + 0.001f;
+		min[u] = lo.x;
+		max[u] = hi.x;
+		min[v] = lo.y;
+		max[v] = hi.y;
+		return AABB(min, max);
+	}
+};
+
+
+//  small random generator that is reseeded for every pixel, so a render gives the
+//  same image no matter which thread (or in which order) a pixel gets rendered
+class PixelRandom {
+public:
+	void seed(unsigned int s, int i, int j) {
+		state = hash(s ^ hash(i * 73856093u ^ hash(j * 19349663u)));
+	}
+
+	// uniform float in [0, 1)
+	float next() {
+		state = state * 747796405u + 2891336453u;
+		unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return ((word >> 22u) ^ word) * (1.0f / 4294967296.0f);
+	}
+	float next(float min, float max) { return min + (max - min) * next(); }
+
+	static unsigned int hash(unsigned int x) {
+		x ^= x >> 16; x *= 0x7feb352du;
+		x ^= x >> 15; x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	unsigned int state = 0;
+};
+
+
 //  Base class for any renderable object in the scene
 class SceneObject {
 public:
+	virtual ~SceneObject() {}
 
 	virtual void draw() = 0;
 	virtual bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) { cout << "SceneObject::intersect" << endl; return false; }
 	virtual glm::vec3 getNormal(const glm::vec3& p) { return glm::vec3(0, 0, 0); }
 	virtual float sdf(const glm::vec3& p) = 0;
 
+	// world space box around the object, false if it is unbounded
+	virtual bool getBounds(AABB& box) const { return false; }
+
+	// change tracking for incremental renders (Renderer::update()). an edit keeps the
+	// bounds the object had before it (an empty box for a new object), takeEdit() then
+	// gives where it was and where it is now, false if either is unbounded
+	void markEdited(bool wasBounded, const AABB& before) {
+		if (edited) return;
+		edited = true;
+		editBounded = wasBounded;
+		editBounds = before;
+	}
+	void markEdited() {
+		AABB box;
+		bool bounded = getBounds(box);
+		markEdited(bounded, box);
+	}
+	bool takeEdit(AABB& box) {
+		edited = false;
+		AABB now;
+		if (!editBounded || !getBounds(now)) return false;
+		box = editBounds;
+		box.grow(now);
+		return true;
+	}
+	bool isEdited() const { return edited; }
+
 	// gui funcions
 	virtual void setupGUI() = 0;
 	virtual void updateGUI() = 0;
 
+	// the panel is only set up once the object is selected, so opening a scene with
+	// many objects doesn't build one for each of them
+	void ensureGUI() {
+		if (guiReady || bHeadless) return;
+		setupGUI();
+		guiReady = true;
+	}
+
 	// currently just used for rendercam
 	glm::mat4 getMatrix() {
 		glm::mat4 T = glm::translate(glm::mat4(1.0), glm::vec3(position));
@@ -59,6 +206,13 @@ public:
 	glm::mat4 transform; // only used for rendercam
 	bool isSelectable = false;
 	bool bSelected = false;
+	bool edited = false;
+	bool editBounded = false;
+	AABB editBounds;            // before the first edit since the last render
+
+	// set by the headless renderer, objects then never get gui panels
+	static bool bHeadless;
+	bool guiReady = false;
 
 	// gui elements & functions
 	ofxPanel gui;
@@ -73,12 +227,28 @@ public:
 	// texture objects & functions
 	void getTextureCoords(glm::vec3 p, float& u, float& v) {}
 	string textureName = "None";
-	ofImage diffuseMap;
-	ofImage specularMap;
+	TextureHandle textureMap;   // shared with the other objects using it, NULL = untextured
 	int numTiles = 1;
 };
 
 
+// how the ray marcher shadows a light, the ray tracer always uses the light's samples
+enum ShadowMode : uint32_t {
+	SHADOW_SAMPLED = 0,     // one shadow ray per light sample
+	SHADOW_PENUMBRA = 1     // one march to the light's center, the penumbra is estimated from how close it passes the scene
+};
+
+
+class Sampler;
+
+// one point on a light as seen from a shaded point
+struct LightSample {
+	glm::vec3 pos;      // point on the light
+	glm::vec3 dir;      // normalized, from the shaded point to pos
+	float dist;         // from the shaded point to pos
+};
+
+
 // general light class for illuminating scene
 class Light : public SceneObject {
 public:
@@ -96,11 +266,25 @@ public:
 	float sdf(const glm::vec3& p) { return 0; }
 
 	// virtual functions - must be overloaded
-	virtual int getRaySamples(glm::vec3 p, glm::vec3 norm) = 0;
+	// sampling leaves the light untouched, so render threads share it. the samples go
+	// to the caller's buffer (no allocations), at most maxSamples of them, the count is
+	// returned. getSampleCount() is the most a light writes. the points on the light
+	// come from the caller's sampler (Sampler.h)
+	virtual int getSampleCount() const = 0;
+	virtual int getSamples(const glm::vec3& p, LightSample* samples, int maxSamples, Sampler& sampler) const = 0;
+
+	// center and size of the light as seen from afar, radius 0 for a point
+	virtual glm::vec3 getCenter() const { return position; }
+	virtual float getRadius() const { return 0; }
+
+	// everywhere a light sample can be
+	bool getBounds(AABB& box) const {
+		box = AABB(position, position);
+		return true;
+	}
 
 	float intensity;
-	vector<Ray> samples;
-	vector<glm::vec3> samplesPos;
+	ShadowMode shadowMode = SHADOW_SAMPLED;
 
 	ofParameter<float> lightIntensity;
 };
@@ -120,7 +304,8 @@ public:
 	void draw() {}
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) { return false; }
 	float sdf(glm::vec3 p) {}
-	int getRaySamples(glm::vec3 p, glm::vec3 norm) {
+	int getSampleCount() const { return 0; }
+	int getSamples(const glm::vec3& p, LightSample* samples, int maxSamples, Sampler& sampler) const {
 		return 0;
 	}
 };
@@ -134,7 +319,6 @@ public:
 		position = p;
 		intensity = i;
 		isSelectable = true;
-		setupGUI();
 	}
 
 	PointLight(glm::vec3 p) {
@@ -142,7 +326,6 @@ public:
 		position = p;
 		intensity = 10.0;
 		isSelectable = true;
-		setupGUI();
 	}
 
 	void setupGUI() {
@@ -162,7 +345,8 @@ public:
 		return (glm::intersectRaySphere(ray.p, ray.d, position, 0.2, point, normal));
 	}
 	float sdf(const glm::vec3& p) { return 0; }
-	int getRaySamples(glm::vec3 p, glm::vec3 norm);
+	int getSampleCount() const { return 1; }
+	int getSamples(const glm::vec3& p, LightSample* samples, int maxSamples, Sampler& sampler) const;
 
 	static int PointLight::ext;
 };
@@ -182,7 +366,6 @@ public:
 		nSamples = samples;
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	AreaLight(glm::vec3 p) {
@@ -196,7 +379,6 @@ public:
 		nSamples = 1;
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	void setupGUI() {
@@ -209,6 +391,7 @@ public:
 		gui.add(divsWidth.set("# Subdivisions (Width)", nDivsWidth, 0, 20));
 		gui.add(divsHeight.set("# Subdivisions (Height)", nDivsHeight, 0, 20));
 		gui.add(numSamples.set("# Light Samples / Cell", nSamples, 1, 5));
+		gui.add(penumbraShadows.set("Penumbra Shadows (Ray March)", shadowMode == SHADOW_PENUMBRA));
 	}
 
 	void updateGUI() {
@@ -219,12 +402,23 @@ public:
 		nDivsWidth = divsWidth;
 		nDivsHeight = divsHeight;
 		nSamples = numSamples;
+		shadowMode = penumbraShadows ? SHADOW_PENUMBRA : SHADOW_SAMPLED;
 	}
 
 	void draw();
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal);
 	float sdf(const glm::vec3& p) { return 0; }
-	int getRaySamples(glm::vec3 p, glm::vec3 norm);
+	int getSampleCount() const { return glm::max(nDivsWidth * nDivsHeight * nSamples, 0); }
+	int getSamples(const glm::vec3& p, LightSample* samples, int maxSamples, Sampler& sampler) const;
+
+	// the grid's own position, and the radius of the disk with its area
+	glm::vec3 getCenter() const { return position; }
+	float getRadius() const { return sqrtf(width * height / PI); }
+	bool getBounds(AABB& box) const {
+		glm::vec3 half(width / 2, 0, height / 2);
+		box = AABB(position - half, position + half);
+		return true;
+	}
 
 	static int AreaLight::ext;
 
@@ -235,6 +429,7 @@ public:
 
 	ofParameter<float> alWidth, alHeight;
 	ofParameter<int> divsWidth, divsHeight, numSamples;
+	ofParameter<bool> penumbraShadows;
 };
 
 
@@ -248,13 +443,11 @@ public:
 		diffuseColor = diffuse;
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	Sphere() {
 		name = string("Sphere ") + to_string(Sphere::ext++);
 		isSelectable = true; 
-		setupGUI(); 
 	}
 
 	void setupGUI() {
@@ -278,19 +471,15 @@ public:
 	}
 	
 	void draw();
-	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) {
-		return (intersectRaySphere(ray.p, ray.d, position, radius, point, normal));
-	}
+	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal);
+	bool hitDistance(const Ray& ray, float& t);
 	glm::vec3 getNormal(const glm::vec3& p) {
 		return glm::normalize(glm::vec3(p - position));
 	}
-	float sdf(const glm::vec3& p) {
-		float x = pow(p.x, 2);
-		float y = pow(p.y, 2);
-		float z = pow(p.z, 2);
-		float length = std::sqrt(x + y + z);
-
-		return length - radius;
+	float sdf(const glm::vec3& p) { return sdfSphere(p, radius); }
+	bool getBounds(AABB& box) const {
+		box = AABB(position - glm::vec3(radius), position + glm::vec3(radius));
+		return true;
 	}
 	void getTextureCoords(glm::vec3 p, float& u, float& v);
 
@@ -308,7 +497,7 @@ public:
 	Plane(glm::vec3 p, glm::vec3 n, ofColor diffuse = ofColor::white, float w = 20, float h = 20) {
 		name = string("Plane ") + to_string(Plane::ext++);
 		position = p; 
-		normal = n;
+		setNormal(n);
 		width = w;
 		height = h;
 		diffuseColor = diffuse;
@@ -333,16 +522,14 @@ public:
 			plane.rotateDeg(180, 1, 0, 0);*/
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	Plane() {
 		name = string("Plane ") + to_string(Plane::ext++);
-		normal = glm::vec3(0, 1, 0);
+		setNormal(glm::vec3(0, 1, 0));
 		plane.rotateDeg(90, 1, 0, 0);
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	void setupGUI() {
@@ -385,39 +572,17 @@ public:
 
 	void draw();
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal);
+	bool hitDistance(const Ray& ray, float& dist) { return getAxisPlane().intersect(ray.p, ray.d, dist); }
 	glm::vec3 getNormal(const glm::vec3& p) { return this->normal; }
+	void setNormal(glm::vec3 n);
+	AxisPlane getAxisPlane();
 
-	// currently renders plane as an infinite plane
-	float sdf(const glm::vec3& p) {
-		float h = 0;
-		glm::vec3 b = glm::vec3(0, 0, 0);
-		float inf = std::numeric_limits<float>::infinity();
-
-		// alter "height" of plane and border box based on normal
-		if (normal.x != 0) {
-			h = p.x - position.x;
-			b = glm::vec3(10, height, width);
-		}
-		else if (normal.y != 0) {
-			h = p.y - position.y;
-			b = glm::vec3(width, 10, height);
-		}
-		else if (normal.z != 0) {
-			h = p.z - position.z;
-			b = glm::vec3(width, height, 10);
-		}
+	// up direction the constructor turns the plane primitive to for normal n
+	static glm::vec3 upDirOf(const glm::vec3& n);
 
-		float infPlane = dot(p, normal) + h;
-		float border = sdBox(p, b / 2);
-
-		return max(infPlane, -border);
-	}
-
-	// box sdf function
-	float sdBox(const glm::vec3& p, glm::vec3 b) {
-		glm::vec3 q = abs(p) - b;
-		return length(max(q, glm::vec3(0, 0, 0)) + min(max(q.x, max(q.y, q.z)), 0.0f));
-	}
+	// currently renders plane as an infinite plane
+	float sdf(const glm::vec3& p) { return sdfPlane(p, position, normal, width, height); }
+	bool getBounds(AABB& box) const { return false; }   // unbounded when ray marched
 
 	void getTextureCoords(glm::vec3 p, float& u, float& v);
 
@@ -430,7 +595,8 @@ public:
 	void backwardNormal(bool& val);
 
 	ofPlanePrimitive plane;
-	glm::vec3 normal;
+	glm::vec3 normal;           // set through setNormal() so axis stays in sync
+	int axis = -1;              // axis the normal points along, -1 if not axis aligned
 
 	static int Plane::ext;
 	float width = 20;
@@ -499,7 +665,7 @@ public:
 		dimensions = glm::vec3(size);
 		level = lvl;
 
-		// faces for intersect function
+		// faces for texture coordinates
 		faces.push_back( new Plane(position - glm::vec3(0, size / 2, 0), glm::vec3(0, -1, 0), diffuseColor, size, size) );	// bot
 		faces.push_back( new Plane(position + glm::vec3(0, size / 2, 0), glm::vec3(0, 1, 0), diffuseColor, size, size) );	// top
 		faces.push_back( new Plane(position - glm::vec3(size / 2, 0, 0), glm::vec3(-1, 0, 0), diffuseColor, size, size) );	// left
@@ -511,7 +677,6 @@ public:
 		}
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	MengerSponge() {
@@ -522,7 +687,7 @@ public:
 		dimensions = glm::vec3(size);
 		level = 1;
 
-		// faces for intersect function
+		// faces for texture coordinates
 		faces.push_back(new Plane(position - glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), diffuseColor, size, size));	// bot
 		faces.push_back(new Plane(position + glm::vec3(0, 1, 0), glm::vec3(0, 1, 0), diffuseColor, size, size));	// top
 		faces.push_back(new Plane(position - glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), diffuseColor, size, size));	// left
@@ -534,7 +699,10 @@ public:
 		}
 
 		isSelectable = true;
-		setupGUI();
+	}
+
+	~MengerSponge() {
+		for (Plane* f : faces) delete f;
 	}
 
 	void setupGUI() {
@@ -542,7 +710,7 @@ public:
 		gui.add(objPos.set("Position", position, glm::vec3(-10, -10, -10),
 			glm::vec3(10, 10, 10)));
 		gui.add(cubeSize.set("Cube Size", dimensions.x, 1, 10));
-		gui.add(msLevel.set("Level", level, 1, 5));
+		gui.add(msLevel.set("Level", level, 1, 10));
 		gui.add(msColor.set("Diffuse Color", diffuseColor, ofColor::white, ofColor::black));
 	}
 
@@ -569,38 +737,10 @@ public:
 	void draw();
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal);
 
-	// code source from https://iquilezles.org/articles/menger
-	float sdf(const glm::vec3& p) {
-
-		// overall cube sdf
-		float dist = sdBox(p, dimensions / 2);
-
-		float s = 1.0;
-
-		// iterate through cube to remove boxes
-		for (int i = 0; i < level; i++) {
-			
-			glm::vec3 a = glm::mod((p * s), 2.0f) - 1.0f;
-			s *= 3;
-			glm::vec3 r = abs(1.0f - 3.0f * abs(a));
-
-			// determine sdf of "cross" inside outer cube
-			float da = max(r.x, r.y);
-			float db = max(r.y, r.z);
-			float dc = max(r.z, r.x);
-			float c = (min(da, min(db, dc)) - 1) / s;
-
-			// remove cross from sdf
-			dist = max(dist, c);
-		}
-
-		return dist;
-	}
-
-	// box sdf function
-	float sdBox(const glm::vec3& p, glm::vec3 b) {
-		glm::vec3 q = abs(p) - b;
-		return length(max(q, glm::vec3(0, 0, 0)) + min(max(q.x, max(q.y, q.z)), 0.0f));
+	float sdf(const glm::vec3& p) { return sdfMenger(p, dimensions, level); }
+	bool getBounds(AABB& box) const {
+		box = AABB(position - dimensions / 2.0f, position + dimensions / 2.0f);
+		return true;
 	}
 
 	glm::vec3 dimensions;
@@ -626,7 +766,6 @@ public:
 		bailout = bail;
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	Mandelbulb() {
@@ -638,7 +777,6 @@ public:
 		bailout = 4.0f;
 
 		isSelectable = true;
-		setupGUI();
 	}
 
 	void setupGUI() {
@@ -646,7 +784,7 @@ public:
 		gui.add(objPos.set("Position", position, glm::vec3(-10, -10, -10),
 			glm::vec3(10, 10, 10)));
 		gui.add(mbIter.set("Max Iterations", iterations, 1, 20));
-		gui.add(mbPower.set("Power", power, 1, 16));
+		gui.add(mbPower.set("Power", (int)roundf(power), 1, 16));
 		gui.add(mbBail.set("Bailout", bailout, 1, 10));
 		gui.add(mbColor.set("Diffuse Color", diffuseColor, ofColor::white, ofColor::black));
 	}
@@ -655,7 +793,9 @@ public:
 		position = objPos;
 
 		iterations = mbIter;
-		power = mbPower;
+		// whole powers only (the fast estimator), a fractional one from a scene file
+		// is kept until the slider is moved
+		if (mbPower != (int)roundf(power)) power = mbPower;
 		bailout = mbBail;
 		diffuseColor = mbColor;
 	}
@@ -663,40 +803,21 @@ public:
 	void draw();
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal);
 
-	// source: http://blog.hvidtfeldts.net/index.php/2011/09/distance-estimated-3d-fractals-v-the-mandelbulb-different-de-approximations
-	float sdf(const glm::vec3& p) {
-		glm::vec3 z = p;
-		float dr = 1.0;
-		float r = 0.0;
-
-		for (int i = 0; i < iterations; i++) {
-			r = length(z);
-			if (r > bailout) break;
-
-			// convert to polar coords
-			float theta = acos(z.z / r);
-			float phi = atan2(z.y, z.x);
-			dr = pow(r, power - 1.0) * power * dr + 1.0;
-
-			// scale and rotate point
-			float zr = pow(r, power);
-			theta = theta * power;
-			phi = phi * power;
-
-			// convert back to cartesian coords
-			z = zr * glm::vec3(sin(theta) * cos(phi), sin(phi) * sin(theta), cos(theta));
-			z += p;
-		}
+	float sdf(const glm::vec3& p) { return sdfMandelbulb(p, iterations, power, bailout); }
 
-		return 0.5 * log(r) * r / dr;
+	// for power >= 2 any point further than 2 from the center escapes
+	bool getBounds(AABB& box) const {
+		if (power < 2) return false;
+		box = AABB(position - glm::vec3(2), position + glm::vec3(2));
+		return true;
 	}
 
 	int iterations;
 	float power;
 	float bailout;
 
-	ofParameter<int> mbIter;
-	ofParameter<float> mbPower, mbBail;
+	ofParameter<int> mbIter, mbPower;
+	ofParameter<float> mbBail;
 	ofParameter<ofColor> mbColor;
 
 	static int Mandelbulb::ext; // keep track of # of mandelbrots created
@@ -788,4 +909,43 @@ public:
 
 	//glm::vec3 aim;
 	//ViewPlane view;          // The camera viewplane, this is the view that we will render 
+};
+
+
+//  snapshot of the render camera taken before a render starts, maps image pixel
+//  coordinates to world space rays so render threads never touch the camera itself
+class RenderView {
+public:
+	// pinhole camera looking from eye at target with a vertical field of view in degrees,
+	// covering an image of width x height pixels (used when there is no ofCamera)
+	void lookAt(glm::vec3 eye, glm::vec3 target, glm::vec3 up, float fov, int width, int height) {
+		glm::vec3 forward = glm::normalize(target - eye);
+		glm::vec3 right = glm::normalize(glm::cross(forward, up));
+		glm::vec3 camUp = glm::cross(right, forward);
+
+		// view plane at distance 1, image y runs downwards
+		float halfHeight = tan(glm::radians(fov) / 2);
+		float halfWidth = halfHeight * width / height;
+
+		this->eye = eye;
+		origin = eye + forward - right * halfWidth + camUp * halfHeight;
+		du = right * (2 * halfWidth / width);
+		dv = -camUp * (2 * halfHeight / height);
+	}
+
+	Ray getRay(float x, float y) const {
+		glm::vec3 p = origin + x * du + y * dv;
+		return Ray(eye, glm::normalize(p - eye));
+	}
+
+	// angle a pixel covers in the middle of the image, a pixel's ray cone is this wide
+	// per unit of distance
+	float getPixelSpread() const {
+		glm::vec3 forward = glm::normalize(glm::cross(du, dv));
+		return glm::length(du) / glm::abs(glm::dot(origin - eye, forward));
+	}
+
+	glm::vec3 eye;          // ray origin (camera position)
+	glm::vec3 origin;       // world position of the image's top left corner
+	glm::vec3 du, dv;       // world space step of one pixel along image x / y
 };
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "RenderScene.h"
+#include "SceneFile.h"
+#include "TextureRegistry.h"
+
+
+void RenderScene::clear() {
+	sphereCenter.clear();
+	sphereRadius.clear();
+	sphereMaterial.clear();
+
+	planeRect.clear();
+	planePosition.clear();
+	planeNormal.clear();
+	planeSize.clear();
+	planeMaterial.clear();
+
+	mengerCenter.clear();
+	mengerSize.clear();
+	mengerLevel.clear();
+	mengerMaterial.clear();
+
+	bulbCenter.clear();
+	bulbIterations.clear();
+	bulbPower.clear();
+	bulbBailout.clear();
+	bulbMaterial.clear();
+
+	materials.clear();
+	uvFrames.clear();
+}
+
+static UVFrame frameOf(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& up, int numTiles) {
+	UVFrame f;
+	f.position = position;
+	f.uAxis = glm::normalize(glm::cross(normal, up)) / (float)numTiles;
+	f.vAxis = glm::normalize(up) / (float)numTiles;
+	return f;
+}
+
+static UVFrame frameOf(Plane* plane) {
+	return frameOf(plane->position, plane->normal, plane->plane.getUpDir(), plane->numTiles);
+}
+
+void RenderScene::addSphere(const glm::vec3& center, float radius) {
+	sphereCenter.push_back(center);
+	sphereRadius.push_back(radius);
+	sphereMaterial.push_back((uint32_t)materials.size());
+}
+
+void RenderScene::addPlane(const glm::vec3& position, const glm::vec3& normal, float width, float height) {
+	planeRect.push_back(AxisPlane::fromRect(position, normal, width, height));
+	planePosition.push_back(position);
+	planeNormal.push_back(normal);
+	planeSize.push_back(glm::vec2(width, height));
+	planeMaterial.push_back((uint32_t)materials.size());
+}
+
+void RenderScene::addMenger(const glm::vec3& center, float size, int level) {
+	mengerCenter.push_back(center);
+	mengerSize.push_back(size);
+	mengerLevel.push_back(level);
+	mengerMaterial.push_back((uint32_t)materials.size());
+}
+
+void RenderScene::addBulb(const glm::vec3& center, int iterations, float power, float bailout) {
+	bulbCenter.push_back(center);
+	bulbIterations.push_back(iterations);
+	bulbPower.push_back(power);
+	bulbBailout.push_back(bailout);
+	bulbMaterial.push_back((uint32_t)materials.size());
+}
+
+void RenderScene::build(const vector<SceneObject*>& scene) {
+	clear();
+
+	for (SceneObject* obj : scene) {
+		Sphere* sphere = dynamic_cast<Sphere*>(obj);
+		Plane* plane = dynamic_cast<Plane*>(obj);
+		MengerSponge* menger = dynamic_cast<MengerSponge*>(obj);
+		Mandelbulb* bulb = dynamic_cast<Mandelbulb*>(obj);
+
+		if (sphere) addSphere(sphere->position, sphere->radius);
+		else if (plane) addPlane(plane->position, plane->normal, plane->width, plane->height);
+		else if (menger) addMenger(menger->position, menger->dimensions.x, menger->level);
+		else if (bulb) addBulb(bulb->position, bulb->iterations, bulb->power, bulb->bailout);
+		else {
+			printf("RenderScene: can't render %s\n", obj->name.c_str());
+			continue;
+		}
+
+		RenderMaterial m;
+		m.diffuse = obj->diffuseColor;
+		if (obj->textureMap) {
+			m.texture = obj->textureMap;
+			m.firstFrame = (uint32_t)uvFrames.size();
+			m.tiles = (float)obj->numTiles;
+			if (sphere) {
+				m.mapping = UV_SPHERE;
+				m.center = sphere->position;
+				m.radius = sphere->radius;
+				m.uvScale = 2 / (PI * obj->numTiles);
+			}
+			else if (plane) {
+				m.mapping = UV_PLANE;
+				m.uvScale = 1.0f / obj->numTiles;
+				uvFrames.push_back(frameOf(plane));
+			}
+			else if (menger) {
+				m.mapping = UV_MENGER;
+				m.uvScale = 1.0f / menger->faces[0]->numTiles;
+				for (Plane* face : menger->faces) uvFrames.push_back(frameOf(face));
+			}
+		}
+		materials.push_back(m);
+	}
+}
+
+// the objects SceneFile::instantiate() would create, in the same order, so the
+// material ids are the same as when rendering those
+void RenderScene::build(const SceneData& data, TextureRegistry& textures) {
+	clear();
+
+	// each material's texture is looked up once, not once per object using it
+	vector<TextureHandle> materialTextures(data.materials.size());
+	for (size_t i = 0; i < data.materials.size(); i++) {
+		const MaterialRecord& r = data.materials[i];
+		materialTextures[i] = textures.get(string(r.texture, strnlen(r.texture, sizeof(r.texture))));
+	}
+
+	// material of record index, the callers set up its texture mapping
+	auto material = [&](uint32_t index, int& tiles) {
+		RenderMaterial m;
+		tiles = 1;
+		if (index < data.materials.size()) {
+			const MaterialRecord& r = data.materials[index];
+			m.diffuse = ofColor(r.diffuse[0], r.diffuse[1], r.diffuse[2], r.diffuse[3]);
+			m.texture = materialTextures[index];
+			tiles = glm::max(r.numTiles, 1);
+		}
+		else m.diffuse = ofColor::white;
+		m.firstFrame = (uint32_t)uvFrames.size();
+		m.tiles = (float)tiles;
+		return m;
+	};
+
+	for (const PlaneRecord& p : data.planes) {
+		addPlane(p.position, p.normal, p.width, p.height);
+		int tiles;
+		RenderMaterial m = material(p.material, tiles);
+		if (m.texture) {
+			m.mapping = UV_PLANE;
+			m.uvScale = 1.0f / tiles;
+			uvFrames.push_back(frameOf(p.position, p.normal, Plane::upDirOf(p.normal), tiles));
+		}
+		materials.push_back(m);
+	}
+	for (const SphereRecord& s : data.spheres) {
+		addSphere(s.position, s.radius);
+		int tiles;
+		RenderMaterial m = material(s.material, tiles);
+		if (m.texture) {
+			m.mapping = UV_SPHERE;
+			m.center = s.position;
+			m.radius = s.radius;
+			m.uvScale = 2 / (PI * tiles);
+		}
+		materials.push_back(m);
+	}
+	for (const MengerRecord& r : data.mengers) {
+		addMenger(r.position, r.size, r.level);
+		int tiles;
+		RenderMaterial m = material(r.material, tiles);
+		if (m.texture) {
+			// the cube's faces, they always have a single tile like MengerSponge's
+			m.mapping = UV_MENGER;
+			m.uvScale = 1;
+			for (int axis = 0; axis < 3; axis++) {
+				for (float side : { -1.0f, 1.0f }) {
+					glm::vec3 normal(0);
+					normal[axis] = side;
+					uvFrames.push_back(frameOf(r.position + normal * (r.size / 2), normal, Plane::upDirOf(normal), 1));
+				}
+			}
+		}
+		materials.push_back(m);
+	}
+	for (const MandelbulbRecord& r : data.mandelbulbs) {
+		addBulb(r.position, r.iterations, r.power, r.bailout);
+		int tiles;
+		materials.push_back(material(r.material, tiles));      // never texture mapped
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Primitives.h"
+#include <cstdint>
+
+class SceneData;
+class TextureRegistry;
+
+// how a material's texture coordinates are computed, UV_NONE = untextured
+enum UVMapping : uint8_t {
+	UV_NONE,
+	UV_PLANE,
+	UV_SPHERE,
+	UV_MENGER           // the plane mapping of the closest of the cube's 6 faces
+};
+
+// texture coordinates of a plane: distance along its u and v axes in tiles
+struct UVFrame {
+	glm::vec3 position;
+	glm::vec3 uAxis, vAxis;     // divided by the tile size
+};
+
+//  surface of one scene object, the primitive arrays refer to these by index (the
+//  material id). everything needed for texture coordinates is copied in, so shading
+//  never goes back to the scene object
+struct RenderMaterial {
+	ofColor diffuse;
+	UVMapping mapping = UV_NONE;
+	TextureHandle texture;          // keeps the texture alive while it is rendered
+	float uvScale = 1;              // how far the texture coordinates move per unit on the surface
+	uint32_t firstFrame = 0;        // planes and menger faces, in RenderScene::uvFrames
+	glm::vec3 center;               // spheres
+	float radius = 1;
+	float tiles = 1;
+};
+
+
+//  render side copy of the scene as structure of arrays
+//
+//  scene objects carry gui panels, images and parameters, far too much to walk
+//  through for every ray. render() takes a snapshot of just the numbers the
+//  kernels need, and the ray tracer and ray marcher only iterate these arrays
+class RenderScene {
+public:
+	void build(const vector<SceneObject*>& scene);
+
+	// the same snapshot straight from scene records, e.g. a mapped .rtsb file, without
+	// creating a scene object (and its constructor and gui) for every record
+	void build(const SceneData& data, TextureRegistry& textures);
+	void clear();
+
+	int objectCount() const { return (int)materials.size(); }
+
+	// spheres
+	vector<glm::vec3> sphereCenter;
+	vector<float> sphereRadius;
+	vector<uint32_t> sphereMaterial;
+
+	// planes, the rectangle is what gets ray traced, the rest feeds the plane sdf
+	vector<AxisPlane> planeRect;
+	vector<glm::vec3> planePosition;
+	vector<glm::vec3> planeNormal;
+	vector<glm::vec2> planeSize;        // width, height
+	vector<uint32_t> planeMaterial;
+
+	// menger sponges, ray traced exactly by intersectMenger()
+	vector<glm::vec3> mengerCenter;
+	vector<float> mengerSize;
+	vector<int> mengerLevel;
+	vector<uint32_t> mengerMaterial;
+
+	// mandelbulbs, ray traced as their unit bounding sphere
+	vector<glm::vec3> bulbCenter;
+	vector<int> bulbIterations;
+	vector<float> bulbPower;
+	vector<float> bulbBailout;
+	vector<uint32_t> bulbMaterial;
+
+	vector<RenderMaterial> materials;   // one per scene object
+	vector<UVFrame> uvFrames;
+
+private:
+	// primitives get the material id of the next material
+	void addSphere(const glm::vec3& center, float radius);
+	void addPlane(const glm::vec3& position, const glm::vec3& normal, float width, float height);
+	void addMenger(const glm::vec3& center, float size, int level);
+	void addBulb(const glm::vec3& center, int iterations, float power, float bailout);
+};
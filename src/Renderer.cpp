@@ -0,0 +1,914 @@
+#include "Renderer.h"
+#include "TextureMap.h"
+
+
+// render the scene through view into pixels (allocated to the view's image size)
+void Renderer::render(RenderMode mode, const vector<SceneObject*>& scene, const vector<Light*>& lights,
+	const RenderView& view, ofPixels& pixels) {
+	cancel();
+	imageComplete = false;
+	prepare(mode, scene, lights, view);
+	renderPrepared(pixels);
+}
+
+void Renderer::render(RenderMode mode, RenderScene&& scene, const vector<Light*>& lights,
+	const RenderView& view, ofPixels& pixels) {
+	cancel();
+	imageComplete = false;
+	renderScene = std::move(scene);
+	prepare(mode, lights, view);
+	renderPrepared(pixels);
+}
+
+// the rest of render() once the snapshot is taken
+void Renderer::renderPrepared(ofPixels& pixels) {
+	int width = pixels.getWidth();
+	int height = pixels.getHeight();
+	FrameBuffer image;
+	image.allocate(width, height);
+	vector<float> imageDepth((size_t)width * height);
+	vector<int> imageIds((size_t)width * height);
+	stats = RenderStats();
+	int samples = glm::max(settings.samplesPerPixel, 1);
+	for (int s = 0; s < samples; s++) {
+		setSample(s);
+		depthOut = s == 0 ? imageDepth.data() : nullptr;
+		objectIdOut = s == 0 ? imageIds.data() : nullptr;
+		renderImage(image, nullptr);
+	}
+	depthOut = nullptr;
+	objectIdOut = nullptr;
+	edgePixels = 0;
+	renderEdges(image, imageDepth.data(), imageIds.data(), samples, settings.edgeSamples, nullptr);
+	setSample(0);
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			pixels.setColor(x, y, toneMapping.apply(image.get(x, y)));
+		}
+	}
+}
+
+// pixel offset and light sampler seed of sample index. the offsets are the R2 sequence
+// (Roberts 2018), evenly spread for any number of samples and starting at the center
+void Renderer::setSample(int index) {
+	sampleIndex = index;
+	sampleOffset = glm::vec2(fmodf(0.5f + index * 0.7548776662f, 1.0f), fmodf(0.5f + index * 0.5698402910f, 1.0f));
+	sampleSeed = settings.seed + index * 0x9E3779B9u;
+}
+
+bool Renderer::tileTakesSample(const FrameBuffer& image, const RenderTile& tile) const {
+	for (int y = tile.y0; y < tile.y1; y++) {
+		for (int x = tile.x0; x < tile.x1; x++) {
+			if (takesSample(image, x, y)) return true;
+		}
+	}
+	return false;
+}
+
+// take the snapshot of the scene the render threads work from and build its index
+void Renderer::prepare(RenderMode mode, const vector<SceneObject*>& scene, const vector<Light*>& lights,
+	const RenderView& view) {
+	renderScene.build(scene);
+	prepare(mode, lights, view);
+}
+
+// the rest of prepare() for a snapshot that is already in renderScene
+void Renderer::prepare(RenderMode mode, const vector<Light*>& lights, const RenderView& view) {
+	this->mode = mode;
+	this->view = view;
+	background = glm::vec3(settings.background.r, settings.background.g, settings.background.b) / 255.0f;
+
+	ShadeModel model = settings.phongShading ? SHADE_PHONG : settings.lambertShading ? SHADE_LAMBERT : SHADE_FLAT;
+	kernels.clear();
+	for (const RenderMaterial& m : renderScene.materials) {
+		kernels.push_back(selectKernel(m.texture ? m.mapping : UV_NONE, model));
+	}
+
+	maxLightSamples = 0;
+	lightBounds.clear();
+	this->lights.clear();
+	for (const Light* light : lights) {
+		// lights without samples (an area light with 0 subdivisions) give off no light,
+		// shading them would average over no samples
+		if (light->intensity <= 0 || light->getSampleCount() == 0) continue;
+		this->lights.push_back({ light, mode == RENDER_RAYMARCH && light->shadowMode == SHADOW_PENUMBRA });
+		maxLightSamples = glm::max(maxLightSamples, light->getSampleCount());
+		AABB box;
+		if (light->getBounds(box)) lightBounds.push_back(Bounds(box));
+	}
+
+	if (mode == RENDER_RAYTRACE) {
+		bvh.build(renderScene);
+	}
+	else {
+		sdfIndex.margin = settings.sdfCullMargin;
+		sdfIndex.build(renderScene);
+	}
+}
+
+// render the current sample of every pixel through the current view into image,
+// tileDone (if set) is called by the thread that rendered a tile once it is finished.
+// changedOnly skips the tiles the edits in dirtyBoxes can't have changed. the counters
+// are added to stats
+void Renderer::renderImage(FrameBuffer& image, const function<void(const RenderTile&)>& tileDone, bool changedOnly) {
+	renderTiles(image, [&](RenderContext& ctx, const RenderTile& tile) {
+		if (cancelRequested) return;
+		if (changedOnly && !tileChanged(tile)) {
+			ctx.stats.tilesSkipped++;
+			return;
+		}
+
+		// edge passes only render a few pixels, tiles without any are left alone. they
+		// aren't counted, the tile counters are about what an update renders again
+		if ((sampleMask || sampleIndex > 0) && !tileTakesSample(image, tile)) return;
+		if (!sampleMask) ctx.stats.tilesRendered++;
+
+		if (mode == RENDER_RAYTRACE) rayTraceTile(ctx, tile, image);
+		else rayMarchTile(ctx, tile, image);
+
+		if (tileDone) tileDone(tile);
+	});
+}
+
+
+// progressive rendering
+
+void Renderer::start(RenderMode mode, const vector<SceneObject*>& scene, const vector<Light*>& lights,
+	const RenderView& view, int width, int height) {
+	cancel();
+
+	// the snapshot is taken here, so the scene may be edited once start() returns
+	prepare(mode, scene, lights, view);
+	{
+		std::lock_guard<std::mutex> lk(displayLock);
+		display.allocate(width, height, OF_PIXELS_RGB);
+		display.setColor(settings.background);
+		displayChanged = true;
+	}
+	accum.allocate(width, height);
+	samplesDone = 0;
+	edgeSamplesDone = 0;
+	edgePixels = 0;
+	depth.assign(width * height, std::numeric_limits<float>::infinity());
+	objectIds.assign(width * height, -1);
+	depthWidth = width;
+	dirtyBoxes.clear();
+	imageComplete = false;
+
+	passesDone = 0;
+	finished = false;
+	rendering = true;
+	worker = std::thread(&Renderer::renderPasses, this, width, height);
+}
+
+bool Renderer::refine() {
+	if (rendering || !imageComplete || !dirtyBoxes.empty()) return false;
+	if (samplesDone >= settings.samplesPerPixel && edgeSamplesDone >= settings.edgeSamples) return false;
+	cancel();
+
+	passesDone = 0;
+	finished = false;
+	rendering = true;
+	worker = std::thread(&Renderer::renderRefine, this);
+	return true;
+}
+
+void Renderer::cancel() {
+	cancelRequested = true;
+	if (worker.joinable()) worker.join();
+	cancelRequested = false;
+	rendering = false;
+}
+
+bool Renderer::fetch(ofPixels& pixels) {
+	std::lock_guard<std::mutex> lk(displayLock);
+	if (!displayChanged) return false;
+
+	pixels = display;
+	displayChanged = false;
+	return true;
+}
+
+// the render threads write accum without the lock, so the whole image is only mapped
+// again when they don't run: right here or at the end of the render
+void Renderer::setToneMapping(const ToneMapping& tone) {
+	std::lock_guard<std::mutex> lk(displayLock);
+	toneMapping = tone;
+	if (rendering) toneStale = true;
+	else retone();
+}
+
+// tone map all of accum into the display again, displayLock has to be held. pixels
+// without samples still show a preview pass
+void Renderer::retone() {
+	if (accum.getWidth() != display.getWidth() || accum.getHeight() != display.getHeight()) return;
+	for (int y = 0; y < accum.getHeight(); y++) {
+		for (int x = 0; x < accum.getWidth(); x++) {
+			if (accum.getSamples(x, y)) display.setColor(x, y, toneMapping.apply(accum.get(x, y)));
+		}
+	}
+	displayChanged = true;
+}
+
+// end of a background render, done = it wasn't cancelled
+void Renderer::finishJob(bool done) {
+	std::lock_guard<std::mutex> lk(displayLock);
+	if (toneStale) retone();
+	toneStale = false;
+	finished = done;
+	rendering = false;
+}
+
+ToneMapping Renderer::getToneMapping() {
+	std::lock_guard<std::mutex> lk(displayLock);
+	return toneMapping;
+}
+
+// background thread of start(): each preview pass renders a smaller image through a
+// view with bigger pixels, its tiles are blown up into the displayed image as they
+// finish. then the full resolution samples
+void Renderer::renderPasses(int width, int height) {
+	RenderView fullView = view;
+
+	for (int pass = 0; pass < previewPasses && !cancelRequested; pass++) {
+		int step = 1 << (previewPasses - pass);     // 8, 4, 2
+		view = fullView;
+		view.du *= step;
+		view.dv *= step;
+
+		FrameBuffer passImage;
+		passImage.allocate((width + step - 1) / step, (height + step - 1) / step);
+		stats = RenderStats();
+
+		renderImage(passImage, [&](const RenderTile& tile) {
+			std::lock_guard<std::mutex> lk(displayLock);
+			for (int j = tile.y0; j < tile.y1; j++) {
+				for (int i = tile.x0; i < tile.x1; i++) {
+					ofColor color = toneMapping.apply(passImage.get(i, j));
+					for (int y = j * step; y < glm::min((j + 1) * step, height); y++) {
+						for (int x = i * step; x < glm::min((i + 1) * step, width); x++) {
+							display.setColor(x, y, color);
+						}
+					}
+				}
+			}
+			displayChanged = true;
+		});
+
+		if (!cancelRequested) passesDone = pass + 1;
+	}
+	view = fullView;
+
+	renderSamples(0, glm::max(settings.samplesPerPixel, 1), false);
+	renderEdgeSamples(settings.edgeSamples);
+	finishJob(!cancelRequested);
+}
+
+// full resolution samples first .. last - 1 into accum, every tile is shown as soon as
+// it has its new sample. the first sample also fills the depth buffer, once it is done
+// the image is complete and can be updated or refined
+void Renderer::renderSamples(int first, int last, bool changedOnly) {
+	for (int s = first; s < last && !cancelRequested; s++) {
+		setSample(s);
+		depthOut = s == 0 ? depth.data() : nullptr;
+		objectIdOut = s == 0 ? objectIds.data() : nullptr;
+		stats = RenderStats();
+		renderImage(accum, [&](const RenderTile& tile) { showTile(tile); }, changedOnly);
+		depthOut = nullptr;
+		objectIdOut = nullptr;
+		if (cancelRequested) break;
+
+		passesDone++;
+		if (!changedOnly) {
+			samplesDone = s + 1;
+			imageComplete = true;
+		}
+	}
+	setSample(0);
+}
+
+// tone map a tile of accum into the display
+void Renderer::showTile(const RenderTile& tile) {
+	std::lock_guard<std::mutex> lk(displayLock);
+	for (int y = tile.y0; y < tile.y1; y++) {
+		for (int x = tile.x0; x < tile.x1; x++) {
+			display.setColor(x, y, toneMapping.apply(accum.get(x, y)));
+		}
+	}
+	displayChanged = true;
+}
+
+// background thread of refine()
+void Renderer::renderRefine() {
+	renderSamples(samplesDone, settings.samplesPerPixel, false);
+	renderEdgeSamples(settings.edgeSamples);
+	finishJob(!cancelRequested);
+}
+
+
+// adaptive anti-aliasing
+//
+// aliasing is where neighbouring pixels differ, along the silhouettes and borders of
+// objects and hard shadows. everywhere else the samples a pixel already has are as good
+// as more of them, so once every pixel has its samples the edges are found from them
+// and only they get the extra ones
+
+// add samples first .. last - 1 to the pixels of image on edges, the depths and object
+// ids are those of its first sample. pixels that only became edges after an update
+// get all the samples they are missing
+void Renderer::renderEdges(FrameBuffer& image, const float* depth, const int* ids, int first, int last,
+	const function<void(const RenderTile&)>& tileDone) {
+	if (first >= last || cancelRequested) return;
+
+	edgePixels = findEdges(image, depth, ids, edges);
+	sampleMask = edges.data();
+	for (int s = first; s < last && !cancelRequested; s++) {
+		setSample(s);
+		renderImage(image, tileDone);
+		if (!cancelRequested) passesDone++;
+	}
+	sampleMask = nullptr;
+	setSample(0);
+}
+
+// edge samples of the progressive image, up to last
+void Renderer::renderEdgeSamples(int last) {
+	renderEdges(accum, depth.data(), objectIds.data(), samplesDone, last, [&](const RenderTile& tile) { showTile(tile); });
+	if (!cancelRequested) edgeSamplesDone = glm::max(last, samplesDone.load());
+}
+
+// mark the pixels that show another object than a neighbour, or whose depth or color
+// differs too much from it, returns how many there are
+int Renderer::findEdges(const FrameBuffer& image, const float* depth, const int* ids, vector<uint8_t>& edges) const {
+	int width = image.getWidth();
+	int height = image.getHeight();
+	edges.assign((size_t)width * height, 0);
+
+	auto differ = [&](int x0, int y0, int x1, int y1) {
+		size_t a = (size_t)y0 * width + x0;
+		size_t b = (size_t)y1 * width + x1;
+		if (ids[a] != ids[b]) return true;
+		if (ids[a] >= 0 && fabsf(depth[a] - depth[b]) > settings.edgeDepth * glm::min(depth[a], depth[b])) return true;
+
+		// highlights are compared as if clamped, above white they hardly show a difference
+		glm::vec3 d = glm::abs(glm::min(image.get(x0, y0), glm::vec3(1)) - glm::min(image.get(x1, y1), glm::vec3(1)));
+		return glm::max(d.r, glm::max(d.g, d.b)) > settings.edgeContrast;
+	};
+
+	// both pixels of a pair that differ are on the edge
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t i = (size_t)y * width + x;
+			if (x + 1 < width && differ(x, y, x + 1, y)) edges[i] = edges[i + 1] = 1;
+			if (y + 1 < height && differ(x, y, x, y + 1)) edges[i] = edges[i + width] = 1;
+		}
+	}
+
+	int count = 0;
+	for (uint8_t e : edges) count += e;
+	return count;
+}
+
+
+// incremental updates
+
+bool Renderer::update(const vector<SceneObject*>& scene, const vector<Light*>& lights, const vector<AABB>& boxes) {
+	cancel();
+	if (!imageComplete) return false;
+
+	// boxes of an update that was cancelled are still in dirtyBoxes, the margin covers
+	// the shadow ray offsets and the ray marcher's hit threshold
+	const float margin = 0.1f;
+	for (const AABB& b : boxes) {
+		dirtyBoxes.push_back(Bounds(AABB(b.min - glm::vec3(margin), b.max + glm::vec3(margin))));
+	}
+
+	prepare(mode, scene, lights, view);
+	passesDone = 0;
+	finished = false;
+	rendering = true;
+	worker = std::thread(&Renderer::renderUpdate, this);
+	return true;
+}
+
+// background thread of update(), renders all the samples the image has again for the
+// changed tiles, the first one replaces what they had. then the edges, which can have
+// moved, get theirs
+void Renderer::renderUpdate() {
+	renderSamples(0, samplesDone, true);
+	renderEdgeSamples(edgeSamplesDone);
+
+	if (!cancelRequested) dirtyBoxes.clear();
+	finishJob(!cancelRequested);
+}
+
+bool Renderer::tileChanged(const RenderTile& tile) const {
+	for (int y = tile.y0; y < tile.y1; y++) {
+		for (int x = tile.x0; x < tile.x1; x++) {
+			if (pixelChanged(x, y)) return true;
+		}
+	}
+	return false;
+}
+
+// does any segment from p to a point within lightRadius of lightCenter pass within
+// radius of center? at distance u along the axis from p to the light those segments
+// are within u * k of it, the closest the sphere's center gets to that cone is the
+// minimum of the convex |center - axis(u)| - u * k
+static bool coneTouchesSphere(const glm::vec3& p, const glm::vec3& lightCenter, float lightRadius,
+	const glm::vec3& center, float radius) {
+	glm::vec3 axis = lightCenter - p;
+	float dist = glm::length(axis);
+	float k = lightRadius / glm::max(dist, 1e-6f);
+	if (k >= 0.99f) return true;
+	axis /= dist;
+
+	glm::vec3 v = center - p;
+	float along = glm::dot(v, axis);
+	float across = glm::length(v - axis * along);
+	float u = glm::clamp(along + k * across / sqrtf(1 - k * k), 0.0f, dist);
+	return glm::length(v - axis * u) - u * k <= radius;
+}
+
+// could the edits in dirtyBoxes have changed the pixel? they can if its camera ray
+// passes through one of them before its hit point, or one of the shadow rays from the
+// hit point to the lights can. the hit point is the one of the last render, it only
+// moves when the camera ray goes through an edit
+bool Renderer::pixelChanged(int x, int y) const {
+	Ray ray = view.getRay(x + 0.5f, y + 0.5f);
+	float t = depth[y * depthWidth + x];
+	glm::vec3 invDir = 1.0f / ray.d;
+	float tNear;
+	for (const Bounds& dirty : dirtyBoxes) {
+		if (dirty.box.intersect(ray.p, invDir, t, tNear)) return true;
+	}
+
+	// unshaded pixels have no shadows
+	if (std::isinf(t) || !(settings.lambertShading || settings.phongShading)) return false;
+
+	glm::vec3 p = ray.p + ray.d * t;
+	for (const Bounds& light : lightBounds) {
+		for (const Bounds& dirty : dirtyBoxes) {
+			if (coneTouchesSphere(p, light.center, light.radius, dirty.center, dirty.radius)) return true;
+		}
+	}
+	return false;
+}
+
+// render every tile of the image, spread over the render threads
+void Renderer::renderTiles(FrameBuffer& image, const function<void(RenderContext&, const RenderTile&)>& renderTile) {
+	scheduler.setThreadCount(settings.threads);
+	vector<RenderContext> contexts(scheduler.getThreadCount());
+	for (RenderContext& ctx : contexts) {
+		ctx.lightSamples.resize(maxLightSamples);
+		ctx.blocked.resize(maxLightSamples);
+	}
+
+	scheduler.run(image.getWidth(), image.getHeight(), settings.tileSize, [&](const RenderTile& tile, int thread) {
+		renderTile(contexts[thread], tile);
+	});
+
+	for (const RenderContext& ctx : contexts) {
+		stats.add(ctx.stats);
+	}
+}
+
+// ray trace a tile in packets of 4 x 2 neighbouring pixels
+void Renderer::rayTraceTile(RenderContext& ctx, const RenderTile& tile, FrameBuffer& image) {
+	RayPacket packet;
+	RayHit hits[RayPacket::width];
+	int pixelX[RayPacket::width], pixelY[RayPacket::width];
+
+	for (int j0 = tile.y0; j0 < tile.y1; j0 += 2) {
+		for (int i0 = tile.x0; i0 < tile.x1; i0 += 4) {
+			packet.clear();
+			for (int j = j0; j < glm::min(j0 + 2, tile.y1); j++) {
+				for (int i = i0; i < glm::min(i0 + 4, tile.x1); i++) {
+					if (!takesSample(image, i, j)) continue;
+					pixelX[packet.count] = i;
+					pixelY[packet.count] = j;
+					packet.add(view.getRay(i + sampleOffset.x, j + sampleOffset.y), std::numeric_limits<float>::infinity());
+				}
+			}
+			if (packet.count == 0) continue;
+			packet.pad();
+
+			// closest object along each ray
+			bvh.intersect(packet, hits);
+
+			for (int k = 0; k < packet.count; k++) {
+				// random numbers only depend on the pixel and sample, not on the thread that renders it
+				ctx.sampler.seed(settings.lightSampler, sampleSeed, pixelX[k], pixelY[k]);
+
+				// color pixel based on the closest object, default to background color if no object
+				const RayHit& hit = hits[k];
+				glm::vec3 color = hit.material >= 0 ? colorPixel(ctx, hit.material, hit.point, hit.normal) : background;
+				writeSample(image, pixelX[k], pixelY[k], color);
+				if (depthOut) {
+					depthOut[pixelY[k] * image.getWidth() + pixelX[k]] = hit.material >= 0 ? glm::distance(view.eye, hit.point)
+						: std::numeric_limits<float>::infinity();
+				}
+				if (objectIdOut) objectIdOut[pixelY[k] * image.getWidth() + pixelX[k]] = hit.material;
+			}
+		}
+	}
+}
+
+// ray march a tile in packets of 4 x 2 neighbouring pixels. the rays of a packet step
+// together, so every step asks the sdf index for all of their distances at once
+void Renderer::rayMarchTile(RenderContext& ctx, const RenderTile& tile, FrameBuffer& image) {
+	const int width = RayPacket::width;
+	glm::vec3 origins[width], dirs[width];
+	MarchState march[width];
+	int material[width];
+	bool hit[width];
+	int pixelX[width], pixelY[width];
+
+	// empty space in front of each block of pixels, from the cone pre-pass
+	int blocksX = (tile.x1 - tile.x0 + coneLeafSize - 1) / coneLeafSize;
+	int blocksY = (tile.y1 - tile.y0 + coneLeafSize - 1) / coneLeafSize;
+	ctx.coneStart.assign(blocksX * blocksY, 0);
+	if (settings.conePrepass) {
+		for (int y = tile.y0; y < tile.y1; y += coneBlockSize) {
+			for (int x = tile.x0; x < tile.x1; x += coneBlockSize) {
+				coneMarchBlock(ctx, tile, x, y, coneBlockSize, 0);
+			}
+		}
+	}
+
+	for (int j0 = tile.y0; j0 < tile.y1; j0 += 2) {
+		for (int i0 = tile.x0; i0 < tile.x1; i0 += 4) {
+			float start = ctx.coneStart[((j0 - tile.y0) / coneLeafSize) * blocksX + (i0 - tile.x0) / coneLeafSize];
+
+			int count = 0;
+			for (int j = j0; j < glm::min(j0 + 2, tile.y1); j++) {
+				for (int i = i0; i < glm::min(i0 + 4, tile.x1); i++) {
+					if (!takesSample(image, i, j)) continue;
+					pixelX[count] = i;
+					pixelY[count] = j;
+					Ray ray = view.getRay(i + sampleOffset.x, j + sampleOffset.y);
+					origins[count] = ray.p;
+					dirs[count] = ray.d;
+					march[count] = MarchState(settings.relaxation);
+					march[count].t = start;
+					material[count] = -1;
+					hit[count] = false;
+					count++;
+				}
+			}
+			if (count == 0) continue;
+
+			// same steps as rayMarch(), rays that hit or escaped drop out of the packet
+			int active[width];
+			int live = count;
+			for (int k = 0; k < count; k++) active[k] = k;
+
+			for (int step = 0; step < settings.maxRaySteps && live > 0; step++) {
+				glm::vec3 p[width];
+				float dist[width];
+				int mat[width];
+				for (int n = 0; n < live; n++) {
+					int k = active[n];
+					p[n] = origins[k] + dirs[k] * march[k].t;
+					mat[n] = material[k];
+				}
+				sdfIndex.distance(p, live, dist, mat);
+
+				int next = 0;
+				for (int n = 0; n < live; n++) {
+					int k = active[n];
+					material[k] = mat[n];
+					MarchResult result = march[k].advance(dist[n], settings.distThreshold, settings.maxDistance,
+						std::numeric_limits<float>::infinity());
+					if (result == MARCH_HIT) hit[k] = true;
+					else if (result == MARCH_CONTINUE) active[next++] = k;
+				}
+				live = next;
+			}
+
+			for (int k = 0; k < count; k++) {
+				ctx.stats.primaryRays++;
+				ctx.stats.primarySteps += march[k].steps;
+
+				// random numbers only depend on the pixel and sample, not on the thread that renders it
+				ctx.sampler.seed(settings.lightSampler, sampleSeed, pixelX[k], pixelY[k]);
+
+				// we hit the object, color the pixel with the material of the closest object
+				glm::vec3 color = background;
+				if (hit[k]) {
+					glm::vec3 p = origins[k] + dirs[k] * march[k].t;
+					ctx.stats.normalSteps++;
+					color = colorPixel(ctx, material[k], p, getNormalRM(p));
+				}
+				writeSample(image, pixelX[k], pixelY[k], color);
+				if (depthOut) depthOut[pixelY[k] * image.getWidth() + pixelX[k]] = hit[k] ? march[k].t : std::numeric_limits<float>::infinity();
+				if (objectIdOut) objectIdOut[pixelY[k] * image.getWidth() + pixelX[k]] = hit[k] ? material[k] : -1;
+			}
+		}
+	}
+}
+
+// cone march a block of the tile, then its four quarters from where it stopped, down to
+// the blocks the rays start from
+void Renderer::coneMarchBlock(RenderContext& ctx, const RenderTile& tile, int x0, int y0, int size, float t) {
+	int x1 = glm::min(x0 + size, tile.x1);
+	int y1 = glm::min(y0 + size, tile.y1);
+	t = coneMarch(ctx, x0, y0, x1, y1, t);
+
+	if (size <= coneLeafSize) {
+		// backed off by the hit threshold, so a ray grazing a surface right past
+		// where the cone stopped still starts in front of it
+		int blocksX = (tile.x1 - tile.x0 + coneLeafSize - 1) / coneLeafSize;
+		ctx.coneStart[((y0 - tile.y0) / coneLeafSize) * blocksX + (x0 - tile.x0) / coneLeafSize] =
+			glm::max(t - settings.distThreshold, 0.0f);
+		return;
+	}
+
+	int half = size / 2;
+	for (int y = y0; y < y1; y += half) {
+		for (int x = x0; x < x1; x += half) {
+			coneMarchBlock(ctx, tile, x, y, half, t);
+		}
+	}
+}
+
+// march along the ray through the middle of pixels [x0, x1) x [y0, y1), starting at t.
+// at distance t every ray of those pixels is within t * spread of it, so while the
+// scene distance is more than that they can all step by the difference, less the hit
+// threshold so none of them gets within it of a surface. returns how far all of them
+// can go that way
+float Renderer::coneMarch(RenderContext& ctx, int x0, int y0, int x1, int y1, float t) {
+	Ray axis = view.getRay((x0 + x1) * 0.5f, (y0 + y1) * 0.5f);
+
+	// the corners of the block are the furthest out
+	float spread = 0;
+	spread = glm::max(spread, glm::length(view.getRay(x0, y0).d - axis.d));
+	spread = glm::max(spread, glm::length(view.getRay(x1, y0).d - axis.d));
+	spread = glm::max(spread, glm::length(view.getRay(x0, y1).d - axis.d));
+	spread = glm::max(spread, glm::length(view.getRay(x1, y1).d - axis.d));
+
+	int material;
+	for (int i = 0; i < settings.maxRaySteps; i++) {
+		float dist = sceneSDF(axis.p + axis.d * t, material);
+		ctx.stats.coneSteps++;
+
+		float step = dist - t * spread - settings.distThreshold;
+		if (step < settings.distThreshold || dist > settings.maxDistance) break;
+		t += step;
+	}
+	return t;
+}
+
+// ray marching algorithm, gives up once the ray has travelled maxDist
+bool Renderer::rayMarch(const Ray& r, glm::vec3& p, int& material, float maxDist, int& steps) {
+	MarchState march(settings.relaxation);
+	MarchResult result = MARCH_CONTINUE;
+	p = r.p;
+
+	for (int i = 0; i < settings.maxRaySteps && result == MARCH_CONTINUE; i++) {
+		result = march.advance(sceneSDF(p, material), settings.distThreshold, settings.maxDistance, maxDist);
+		p = r.p + r.d * march.t;
+	}
+
+	steps = march.steps;
+	return result == MARCH_HIT;
+}
+
+// checking scene for closest object in the scene, only objects near p are evaluated
+float Renderer::sceneSDF(const glm::vec3& p, int& material) {
+	return sdfIndex.distance(p, material);
+}
+
+// gradient of the sdf from a single evaluation with dual numbers, no epsilon to tune
+glm::vec3 Renderer::getNormalRM(const glm::vec3& p) {
+	return sdfIndex.normal(p);
+}
+
+// shading kernels
+
+Renderer::ShadeKernel Renderer::selectKernel(UVMapping uv, ShadeModel model) const {
+	switch (uv) {
+	case UV_PLANE: return selectKernel<UV_PLANE>(model);
+	case UV_SPHERE: return selectKernel<UV_SPHERE>(model);
+	case UV_MENGER: return selectKernel<UV_MENGER>(model);
+	default: return selectKernel<UV_NONE>(model);
+	}
+}
+
+template <UVMapping uv>
+Renderer::ShadeKernel Renderer::selectKernel(ShadeModel model) const {
+	switch (model) {
+	case SHADE_LAMBERT: return selectKernel<uv, SHADE_LAMBERT>();
+	case SHADE_PHONG: return selectKernel<uv, SHADE_PHONG>();
+	default: return selectKernel<uv, SHADE_FLAT>();
+	}
+}
+
+template <UVMapping uv, ShadeModel model>
+Renderer::ShadeKernel Renderer::selectKernel() const {
+	if (mode == RENDER_RAYTRACE) return &Renderer::shadeKernel<uv, model, RENDER_RAYTRACE>;
+	return &Renderer::shadeKernel<uv, model, RENDER_RAYMARCH>;
+}
+
+// texture coordinates of p, the same as the objects' getTextureCoords() without the
+// wrap around, texture lookups wrap anyway
+template <UVMapping uv>
+static inline void textureCoords(const RenderScene& scene, const RenderMaterial& m, const glm::vec3& p, float& u, float& v) {
+	if (uv == UV_SPHERE) {
+		glm::vec3 point = p - m.center;
+		float theta = asinf(point.y / glm::length(point));
+		float phi = atan2f(point.z, point.x);
+		u = phi / TWO_PI * m.radius * 4 / m.tiles;
+		v = (theta + PI) / TWO_PI * m.radius * 4 / m.tiles;
+		return;
+	}
+
+	// planes have one frame, menger sponges use the closest of their faces
+	const UVFrame* frame = &scene.uvFrames[m.firstFrame];
+	if (uv == UV_MENGER) {
+		const UVFrame* faces = frame;
+		float dist = glm::distance(faces[0].position, p);
+		for (int i = 1; i < 6; i++) {
+			float d = glm::distance(faces[i].position, p);
+			if (d < dist) {
+				dist = d;
+				frame = &faces[i];
+			}
+		}
+	}
+	glm::vec3 point = p - frame->position;
+	u = glm::dot(point, frame->uAxis);
+	v = glm::dot(point, frame->vAxis);
+}
+
+// linear color of a sample showing material at p. colors are 0 - 1 and not clamped,
+// bright highlights are left to the tone mapping
+template <UVMapping uv, ShadeModel model, RenderMode rmode>
+glm::vec3 Renderer::shadeKernel(RenderContext& ctx, const RenderMaterial& material, const glm::vec3& p, const glm::vec3& n) {
+	glm::vec3 color = glm::vec3(material.diffuse.r, material.diffuse.g, material.diffuse.b) / 255.0f;
+	float power = settings.phongPower;
+
+	if (uv != UV_NONE) {
+		float texU, texV;
+		textureCoords<uv>(renderScene, material, p, texU, texV);
+
+		// size of the pixel on the texture: the pixel's ray cone at this distance,
+		// stretched by how much the surface is turned away from the camera
+		glm::vec3 d = p - view.eye;
+		float t = glm::length(d);
+		float cosine = glm::max(fabsf(glm::dot(n, d / t)), 0.05f);
+		float footprint = t * view.getPixelSpread() / cosine * material.uvScale;
+
+		// diffuse color and specular coefficient from one filtered lookup
+		glm::vec4 texel = material.texture->sample(texU, texV, footprint);
+		color = glm::vec3(texel.r, texel.g, texel.b) / 255.0f;
+		if (model == SHADE_PHONG) power = texel.a;
+	}
+
+	if (model == SHADE_FLAT) return color;
+	return shading<model, rmode>(ctx, p, n, color, glm::vec3(1), power);
+}
+
+// shading (lambert / phong)
+template <ShadeModel model, RenderMode rmode>
+glm::vec3 Renderer::shading(RenderContext& ctx, const glm::vec3& p, const glm::vec3& norm,
+	const glm::vec3& diffuse, const glm::vec3& specular, float power) {
+
+	glm::vec3 result = settings.ambientIntensity * diffuse;
+	glm::vec3 viewDirection = glm::normalize(view.eye - p);
+	float totalDiffuse = 0;
+	float totalSpecular = 0;
+
+	for (const ShadeLight& shadeLight : lights) {
+		const Light* light = shadeLight.light;
+
+		// calculate effect of lights
+		int numRays = light->getSamples(p, ctx.lightSamples.data(), (int)ctx.lightSamples.size(), ctx.sampler); // get ray(s) from light
+
+		// penumbra lights shade all the samples, one march gives the visible fraction for all of them
+		float visibility = 1;
+		if (shadeLight.penumbra) {
+			visibility = penumbraRM(ctx, p, norm, light->getCenter(), light->getRadius());
+			std::fill(ctx.blocked.begin(), ctx.blocked.begin() + numRays, 0);
+		}
+		else {
+			// adaptive: a few probes spread over the light go first. when they agree the
+			// point is taken as fully lit or fully shadowed and the other samples copy
+			// them, only the penumbra pays for all the shadow rays
+			int probes = settings.adaptiveShadows ? glm::min(glm::max(settings.shadowProbes, 1), numRays) : numRays;
+			int blocked = traceShadows<rmode>(ctx, p, norm, 0, probes);
+			if (probes < numRays) {
+				if (blocked == 0 || blocked == probes) {
+					std::fill(ctx.blocked.begin() + probes, ctx.blocked.begin() + numRays, blocked ? 1 : 0);
+					ctx.stats.lightSamplesSkipped += numRays - probes;
+				}
+				else traceShadows<rmode>(ctx, p, norm, probes, numRays - probes);
+			}
+		}
+		ctx.stats.lightSamples += numRays;
+
+		for (int i = 0; i < numRays; i++) {
+			if (ctx.blocked[i]) continue;
+			const LightSample& sample = ctx.lightSamples[i];
+
+			// calculate intensity of light with respect to distance
+			float illumination = visibility * light->intensity / (sample.dist * sample.dist);
+
+			// lambert formula
+			float lambertCalc = glm::max(glm::dot(norm, sample.dir), 0.0f);
+			totalDiffuse += lambertCalc * illumination;
+
+			// specular formula
+			if (model == SHADE_PHONG) {
+				glm::vec3 h = glm::normalize(viewDirection + sample.dir);
+				float specularCalc = glm::pow(glm::max(glm::dot(norm, h), 0.0f), power);
+				totalSpecular += specularCalc * illumination;
+			}
+		}
+
+		result += (diffuse * (totalDiffuse / numRays)) + (specular * (totalSpecular / numRays));
+	}
+
+	return result;
+}
+
+
+// offset from the light sample so the light's own position never counts as an occluder
+static const float shadowEps = 0.001;
+static const float shadowStartRM = 0.08;     // shadow marches start this far out to avoid self intersection
+
+// check which of the light samples first .. first + count are blocked on their way
+// from p to the light, into ctx.blocked. objects behind the light sample do not cast
+// a shadow. returns how many are blocked
+template <RenderMode rmode>
+int Renderer::traceShadows(RenderContext& ctx, const glm::vec3& p, const glm::vec3& norm, int first, int count) {
+	ShadowBatch& shadows = ctx.shadows;
+	shadows.clear();
+	glm::vec3 origin = p + norm * 0.01f;
+	for (int i = first; i < first + count; i++) {
+		const LightSample& sample = ctx.lightSamples[i];
+		shadows.add(Ray(origin, sample.dir), sample.dist - shadowEps);
+	}
+
+	if (rmode == RENDER_RAYTRACE) {
+		bvh.occluded(shadows);
+	}
+	else {
+		for (int i = 0; i < count; i++) {
+			shadows.blocked[i] = inShadowRM(ctx, shadows.rays[i], shadows.tMax[i]);
+		}
+	}
+
+	int numBlocked = 0;
+	for (int i = 0; i < count; i++) {
+		ctx.blocked[first + i] = shadows.blocked[i];
+		numBlocked += shadows.blocked[i];
+	}
+	return numBlocked;
+}
+
+// ray marching: check to see if Point p is in a shadow cast by light shining along Ray r
+bool Renderer::inShadowRM(RenderContext& ctx, const Ray& r, float maxDist) {
+	glm::vec3 point;
+	int obj;
+	int steps;
+	bool hit = rayMarch(Ray(r.p + r.d * shadowStartRM, r.d), point, obj, maxDist - shadowStartRM, steps);
+	ctx.stats.shadowRays++;
+	ctx.stats.shadowSteps += steps;
+	return hit;
+}
+
+// soft shadow from a single march toward the light's center. where the ray passes
+// the scene at distance h after t, h / t is the angle it clears it by, relative to
+// the light's angular radius (radius / distance) that runs from -1 (light hidden)
+// to 1 (light fully visible). the march goes on through occluders, so the ratio
+// turns negative inside the hard shadow and the penumbra is centered on its edge
+float Renderer::penumbraRM(RenderContext& ctx, const glm::vec3& p, const glm::vec3& norm, const glm::vec3& target, float radius) {
+	glm::vec3 origin = p + norm * 0.01f;
+	float dist = glm::distance(origin, target);
+	glm::vec3 d = (target - origin) / dist;
+	float k = radius > 0 ? dist / radius : 1e6f;   // a point light gets a hard shadow
+
+	float visible = 1;
+	float t = shadowStartRM;
+	int steps = 0;
+	int material;
+	while (steps < settings.maxRaySteps && t < dist - shadowEps) {
+		float h = sceneSDF(origin + d * t, material);
+		steps++;
+		if (h > settings.maxDistance) break;
+
+		visible = glm::min(visible, k * h / t);
+		if (visible < -1) break;
+
+		// no over-relaxation, it would step over the closest approach
+		t += glm::max(fabsf(h), settings.distThreshold);
+	}
+	ctx.stats.shadowRays++;
+	ctx.stats.shadowSteps += steps;
+
+	// smoothstep from -1..1 to 0..1
+	visible = glm::max(visible, -1.0f);
+	return 0.25f * (1 + visible) * (1 + visible) * (2 - visible);
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Primitives.h"
+#include "TileScheduler.h"
+#include "RenderScene.h"
+#include "BVH.h"
+#include "SDFIndex.h"
+#include "Sampler.h"
+#include "FrameBuffer.h"
+
+
+enum RenderMode {
+	RENDER_RAYTRACE,
+	RENDER_RAYMARCH
+};
+
+// lighting model, from the shading settings
+enum ShadeModel {
+	SHADE_FLAT,             // diffuse color only
+	SHADE_LAMBERT,
+	SHADE_PHONG             // lambert + specular
+};
+
+
+// render counters, summed over the render threads
+struct RenderStats {
+	void add(const RenderStats& s) {
+		primaryRays += s.primaryRays;
+		primarySteps += s.primarySteps;
+		shadowRays += s.shadowRays;
+		shadowSteps += s.shadowSteps;
+		coneSteps += s.coneSteps;
+		normalSteps += s.normalSteps;
+		lightSamples += s.lightSamples;
+		lightSamplesSkipped += s.lightSamplesSkipped;
+		tilesRendered += s.tilesRendered;
+		tilesSkipped += s.tilesSkipped;
+	}
+	float stepsPerPrimaryRay() const { return primaryRays ? (float)primarySteps / primaryRays : 0; }
+	float stepsPerShadowRay() const { return shadowRays ? (float)shadowSteps / shadowRays : 0; }
+	uint64_t sdfCalls() const { return primarySteps + shadowSteps + coneSteps + normalSteps; }
+	float skippedLightSamples() const { return lightSamples ? (float)lightSamplesSkipped / lightSamples : 0; }
+
+	uint64_t primaryRays = 0, primarySteps = 0;
+	uint64_t shadowRays = 0, shadowSteps = 0;
+	uint64_t coneSteps = 0;         // cone pre-pass
+	uint64_t normalSteps = 0;       // dual number evaluations for the normals
+	uint64_t lightSamples = 0;          // shadow tested light samples, both modes
+	uint64_t lightSamplesSkipped = 0;   // of those, answered by the probes without a shadow ray
+	uint64_t tilesRendered = 0;
+	uint64_t tilesSkipped = 0;          // left as they were by an incremental update
+};
+
+
+// per-thread scratch state used while rendering tiles
+struct RenderContext {
+	Sampler sampler;            // reseeded for every pixel
+	vector<LightSample> lightSamples;   // sized for the light with the most samples
+	ShadowBatch shadows;
+	vector<uint8_t> blocked;    // per light sample, set by traceShadows()
+	RenderStats stats;
+	vector<float> coneStart;    // where the rays of each 4 x 4 block of the tile start marching
+};
+
+
+//  sphere tracing state of one ray
+//
+//  with relaxation > 1 the steps are relaxation * dist (over-relaxed / enhanced sphere
+//  tracing, Keinert et al. 2014). that is only safe while the unbounding spheres of
+//  two steps overlap; when they don't, the ray goes back to where a plain step would
+//  have ended and carries on with plain steps
+enum MarchResult {
+	MARCH_CONTINUE,
+	MARCH_HIT,
+	MARCH_MISS
+};
+
+struct MarchState {
+	MarchState(float relaxation = 1) : omega(relaxation) {}
+
+	// dist is the scene distance at t
+	MarchResult advance(float dist, float distThreshold, float maxDistance, float maxT) {
+		steps++;
+
+		if (omega > 1 && fabsf(dist) + prevDist < step) {
+			t -= step - prevDist;
+			step = prevDist;
+			omega = 1;
+			return MARCH_CONTINUE;
+		}
+
+		if (dist < distThreshold) return MARCH_HIT;
+		if (dist > maxDistance || t > maxT) return MARCH_MISS;
+
+		prevDist = dist;
+		step = dist * omega;
+		t += step;
+		return MARCH_CONTINUE;
+	}
+
+	float t = 0;
+	float omega;
+	float prevDist = 0;
+	float step = 0;         // the step that led to t
+	int steps = 0;
+};
+
+
+// everything the renderer needs to know besides the scene itself,
+// filled in from the gui by ofApp or from the command line when headless
+struct RenderSettings {
+	// shading
+	bool lambertShading = false;
+	bool phongShading = false;
+	float phongPower = 10;
+	float ambientIntensity = 0.1;
+	ofColor background = ofColor::gray;
+
+	// image
+	static constexpr int maxSamplesPerPixel = 64;     // both counts, FrameBuffer counts samples in 16 bits
+	int samplesPerPixel = 1;    // the first through the pixel centers, the rest jittered
+	int edgeSamples = 0;        // samples per pixel along edges (adaptive anti-aliasing), off up to samplesPerPixel
+	float edgeContrast = 0.1;   // color difference to a neighbour (per channel, 1 = white) that makes an edge
+	float edgeDepth = 0.05;     // so does a depth difference of this much of the nearer one
+
+	// threads
+	int threads = 0;            // 0 = all cores
+	int tileSize = 32;
+	unsigned int seed = 0;
+	SamplerType lightSampler = SAMPLER_SOBOL;  // points on area lights
+	bool adaptiveShadows = false;   // probe area lights first, trace all their samples only in the penumbra
+	int shadowProbes = 8;
+
+	// ray marching
+	int maxRaySteps = 1000;
+	float distThreshold = 0.01;
+	float maxDistance = 100;
+	float relaxation = 1;       // over-relaxed sphere tracing above 1, 1.2 - 1.8 is a good range
+	bool conePrepass = false;   // march cones over blocks of pixels first, the rays start where they stopped
+	float sdfCullMargin = 0.1;  // objects further than this from the sample point only use their bounds
+};
+
+
+//  ray tracer / ray marcher
+//  renders a scene into a pixel buffer, only needs a RenderView for the camera so it
+//  runs the same from the gui app and from the headless command line
+class Renderer {
+public:
+	~Renderer() { cancel(); }
+
+	// render the whole image with all its samples, returns when it is done
+	void render(RenderMode mode, const vector<SceneObject*>& scene, const vector<Light*>& lights,
+		const RenderView& view, ofPixels& pixels);
+
+	// the same from a snapshot built without scene objects (RenderScene::build(SceneData)),
+	// the renderer takes it over
+	void render(RenderMode mode, RenderScene&& scene, const vector<Light*>& lights,
+		const RenderView& view, ofPixels& pixels);
+
+	// progressive render on a background thread, returns right away. the image is
+	// rendered at 1/8, 1/4, 1/2 and then full resolution, every pass covers the whole
+	// image so there is something to show as soon as the first (cheap) one is done.
+	// the full resolution passes then go on adding a sample per pixel each, up to
+	// settings.samplesPerPixel, into a float image that is tone mapped for display,
+	// and pixels on edges get more, up to settings.edgeSamples.
+	// settings must not change until the render is finished or cancelled
+	void start(RenderMode mode, const vector<SceneObject*>& scene, const vector<Light*>& lights,
+		const RenderView& view, int width, int height);
+
+	// add samples to the finished image up to settings.samplesPerPixel (and its edges up
+	// to settings.edgeSamples), in the background like start(), without rendering the
+	// samples it already has again. false when there is no finished image or it has
+	// that many samples already
+	bool refine();
+
+	// re-render the parts of the finished image that edits can have changed, in the
+	// background like start(). boxes are world space bounds around everything edited
+	// since the last render (where moved objects were and where they are now). only
+	// tiles with a pixel whose camera ray or shadow rays can pass through one of them
+	// are rendered again, at full resolution, the rest of the image is kept. mode, view,
+	// image size and settings have to be those of the last render. returns false,
+	// without starting anything, when there is no finished image to update
+	bool update(const vector<SceneObject*>& scene, const vector<Light*>& lights, const vector<AABB>& boxes);
+
+	// stop the background render, returns once its threads are done with the scene
+	void cancel();
+
+	// copy the image rendered so far into pixels, false if it didn't change since the last call
+	bool fetch(ofPixels& pixels);
+
+	// tone mapping of the displayed image, can change at any time: the image is mapped
+	// again from its float samples, nothing is rendered (while rendering: new tiles use
+	// it right away, the rest of the image once the render is done)
+	void setToneMapping(const ToneMapping& tone);
+	ToneMapping getToneMapping();
+
+	// counters of the last render (the last pass of a progressive one, with its edge samples)
+	const RenderStats& getStats() const { return stats; }
+	int getEdgePixels() const { return edgePixels; }   // pixels the last render found on edges
+
+	bool isRendering() const { return rendering; }
+	bool isFinished() const { return !rendering && finished; }
+	int getPassesDone() const { return passesDone; }
+	int getSamplesDone() const { return samplesDone; }  // samples every pixel of the image has
+	int getEdgeSamplesDone() const { return edgeSamplesDone; }  // samples the pixels on edges have
+
+	static const int previewPasses = 3;     // 1/8, 1/4 and 1/2 resolution
+
+	RenderSettings settings;
+	TileScheduler scheduler;
+
+private:
+	void prepare(RenderMode mode, const vector<SceneObject*>& scene, const vector<Light*>& lights,
+		const RenderView& view);
+	void prepare(RenderMode mode, const vector<Light*>& lights, const RenderView& view);
+	void renderPrepared(ofPixels& pixels);
+	void renderImage(FrameBuffer& image, const function<void(const RenderTile&)>& tileDone, bool changedOnly = false);
+	void renderPasses(int width, int height);
+	void renderSamples(int first, int last, bool changedOnly);
+	void renderUpdate();
+	void renderRefine();
+	void renderEdges(FrameBuffer& image, const float* depth, const int* ids, int first, int last,
+		const function<void(const RenderTile&)>& tileDone);
+	void renderEdgeSamples(int last);
+	int findEdges(const FrameBuffer& image, const float* depth, const int* ids, vector<uint8_t>& edges) const;
+	void finishJob(bool done);
+	void showTile(const RenderTile& tile);
+	void retone();
+	bool tileChanged(const RenderTile& tile) const;
+	bool pixelChanged(int x, int y) const;
+	void renderTiles(FrameBuffer& image, const function<void(RenderContext&, const RenderTile&)>& renderTile);
+	void setSample(int index);
+	bool tileTakesSample(const FrameBuffer& image, const RenderTile& tile) const;
+
+	// pixels only get the sample being rendered when they don't have it yet (a cancelled
+	// refine can have added it) and, in edge passes, when they are on an edge
+	bool takesSample(const FrameBuffer& image, int x, int y) const {
+		if (sampleMask && !sampleMask[y * image.getWidth() + x]) return false;
+		return sampleIndex == 0 || image.getSamples(x, y) == sampleIndex;
+	}
+	void writeSample(FrameBuffer& image, int x, int y, const glm::vec3& color) {
+		if (sampleIndex == 0) image.set(x, y, color);
+		else image.add(x, y, color);
+	}
+
+	// raytrace functions
+	void rayTraceTile(RenderContext& ctx, const RenderTile& tile, FrameBuffer& image);
+
+	// raymarch functions
+	void rayMarchTile(RenderContext& ctx, const RenderTile& tile, FrameBuffer& image);
+	void coneMarchBlock(RenderContext& ctx, const RenderTile& tile, int x0, int y0, int size, float t);
+	float coneMarch(RenderContext& ctx, int x0, int y0, int x1, int y1, float t);
+	static const int coneBlockSize = 16;    // biggest cones, halved down to
+	static const int coneLeafSize = 4;      // the blocks the rays start from, a multiple of the 4 x 2 packets
+	bool rayMarch(const Ray& r, glm::vec3& p, int& material, float maxDist, int& steps);
+	float sceneSDF(const glm::vec3& p, int& material);
+	bool inShadowRM(RenderContext& ctx, const Ray& r, float maxDist);
+	float penumbraRM(RenderContext& ctx, const glm::vec3& p, const glm::vec3& norm, const glm::vec3& target, float radius);
+	glm::vec3 getNormalRM(const glm::vec3& p);
+
+	// general rendering functions
+	//
+	// every material is shaded by the kernel for its uv mapping, the shading model and
+	// the render mode, prepare() picks it once per render. the kernels are templates,
+	// so none of that is looked at again per pixel or per light sample
+	typedef glm::vec3 (Renderer::*ShadeKernel)(RenderContext& ctx, const RenderMaterial& material,
+		const glm::vec3& p, const glm::vec3& n);
+	glm::vec3 colorPixel(RenderContext& ctx, uint32_t material, const glm::vec3& p, const glm::vec3& n) {
+		return (this->*kernels[material])(ctx, renderScene.materials[material], p, n);
+	}
+	ShadeKernel selectKernel(UVMapping uv, ShadeModel model) const;
+	template <UVMapping uv> ShadeKernel selectKernel(ShadeModel model) const;
+	template <UVMapping uv, ShadeModel model> ShadeKernel selectKernel() const;
+	template <UVMapping uv, ShadeModel model, RenderMode rmode>
+	glm::vec3 shadeKernel(RenderContext& ctx, const RenderMaterial& material, const glm::vec3& p, const glm::vec3& n);
+	template <ShadeModel model, RenderMode rmode>
+	glm::vec3 shading(RenderContext& ctx, const glm::vec3& p, const glm::vec3& norm,
+		const glm::vec3& diffuse, const glm::vec3& specular, float power);
+	template <RenderMode rmode>
+	int traceShadows(RenderContext& ctx, const glm::vec3& p, const glm::vec3& norm, int first, int count);
+
+	// scene being rendered, set at the start of render()
+	RenderScene renderScene;
+	vector<ShadeKernel> kernels;        // per material
+	struct ShadeLight {
+		const Light* light;
+		bool penumbra;          // shadowed by one penumbra march instead of its samples
+	};
+	vector<ShadeLight> lights;          // the ones that give off light
+	int maxLightSamples = 0;
+	RenderView view;
+	RenderMode mode = RENDER_RAYTRACE;
+	glm::vec3 background;       // settings.background as a linear color
+	SceneBVH bvh;               // ray traced scene, rebuilt for every render
+	SDFIndex sdfIndex;          // ray marched scene, rebuilt for every render
+	RenderStats stats;
+
+	// incremental updates
+	struct Bounds {
+		Bounds(const AABB& b) : box(b), center(b.center()), radius(glm::length(b.max - b.min) / 2) {}
+		AABB box;
+		glm::vec3 center;
+		float radius;           // of the sphere around the box
+	};
+	vector<float> depth;        // hit distance of every pixel of the full resolution image, infinity = background
+	int depthWidth = 0;
+	float* depthOut = nullptr;  // where the pass being rendered writes its hit distances, full resolution only
+	vector<int> objectIds;      // material (= scene object) every pixel shows, -1 = background
+	int* objectIdOut = nullptr; // written along with depthOut
+	vector<Bounds> dirtyBoxes;  // edits not rendered yet, grown by a margin
+	vector<Bounds> lightBounds; // where the samples of the lights that shade can be
+	bool imageComplete = false; // every pixel has samplesDone samples, apart from dirtyBoxes
+
+	// samples
+	int sampleIndex = 0;        // of the pass being rendered, 0 = through the pixel centers
+	glm::vec2 sampleOffset = glm::vec2(0.5f);  // in the pixel
+	unsigned int sampleSeed = 0;    // light sampler seed of the pass
+	FrameBuffer accum;          // full resolution samples of the progressive render
+	std::atomic<int> samplesDone{ 0 };
+
+	// adaptive anti-aliasing
+	vector<uint8_t> edges;      // pixels on edges, the ones edge passes render
+	const uint8_t* sampleMask = nullptr;    // edges while an edge pass runs, all pixels take samples without it
+	std::atomic<int> edgeSamplesDone{ 0 };
+	std::atomic<int> edgePixels{ 0 };
+
+	// progressive rendering
+	std::thread worker;
+	std::atomic<bool> cancelRequested{ false };
+	std::atomic<bool> rendering{ false };
+	std::atomic<bool> finished{ false };
+	std::atomic<int> passesDone{ 0 };
+	std::mutex displayLock;
+	ofPixels display;           // image handed out by fetch(), guarded by displayLock
+	bool displayChanged = false;
+	ToneMapping toneMapping;    // guarded by displayLock
+	bool toneStale = false;     // changed during a render, the display is mapped again at its end
+};
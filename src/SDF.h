@@ -0,0 +1,111 @@
+#pragma once
+
+#include "ofMain.h"
+
+
+//  signed distance functions, shared by the scene objects' sdf() and the renderer
+//  p is relative to the object's position
+//
+//  templates over the vector type: glm::vec3 gives the distance, DualVec3 (Dual.h)
+//  the distance together with its gradient
+
+
+// box sdf function
+template <class V, class S = typename V::value_type>
+inline S sdfBox(const V& p, glm::vec3 b) {
+	V q = abs(p) - b;
+	return length(max(q, glm::vec3(0, 0, 0)) + min(max(q.x, max(q.y, q.z)), 0.0f));
+}
+
+template <class V, class S = typename V::value_type>
+inline S sdfSphere(const V& p, float radius) {
+	return length(p) - radius;
+}
+
+// currently renders plane as an infinite plane
+template <class V, class S = typename V::value_type>
+inline S sdfPlane(const V& p, const glm::vec3& position, const glm::vec3& normal, float width, float height) {
+	S h = 0;
+	glm::vec3 b = glm::vec3(0, 0, 0);
+
+	// alter "height" of plane and border box based on normal
+	if (normal.x != 0) {
+		h = p.x - position.x;
+		b = glm::vec3(10, height, width);
+	}
+	else if (normal.y != 0) {
+		h = p.y - position.y;
+		b = glm::vec3(width, 10, height);
+	}
+	else if (normal.z != 0) {
+		h = p.z - position.z;
+		b = glm::vec3(width, height, 10);
+	}
+
+	S infPlane = dot(p, V(normal)) + h;
+	S border = sdfBox(p, b / 2);
+
+	return max(infPlane, -border);
+}
+
+// code source from https://iquilezles.org/articles/menger
+// the pattern is laid out for a cube of size 2, p is scaled into that and the distance back
+template <class V, class S = typename V::value_type>
+inline S sdfMenger(const V& p, const glm::vec3& dimensions, int level) {
+	float scale = dimensions.x / 2;
+	V q = p / scale;
+
+	// overall cube sdf, negative inside (sdfBox() isn't, sdfPlane() depends on that)
+	V b = abs(q) - V(glm::vec3(1));
+	S dist = length(max(b, V(glm::vec3(0, 0, 0)))) + min(max(b.x, max(b.y, b.z)), S(0));
+
+	float s = 1.0;
+
+	// iterate through cube to remove boxes
+	for (int i = 0; i < level; i++) {
+
+		V a = mod((q * s), 2.0f) - S(1);
+		s *= 3;
+		V r = abs(S(1) - S(3) * abs(a));
+
+		// determine sdf of "cross" inside outer cube
+		S da = max(r.x, r.y);
+		S db = max(r.y, r.z);
+		S dc = max(r.z, r.x);
+		S c = (min(da, min(db, dc)) - S(1)) / S(s);
+
+		// remove cross from sdf
+		dist = max(dist, c);
+	}
+
+	return dist * scale;
+}
+
+// source: http://blog.hvidtfeldts.net/index.php/2011/09/distance-estimated-3d-fractals-v-the-mandelbulb-different-de-approximations
+template <class V, class S = typename V::value_type>
+inline S sdfMandelbulb(const V& p, int iterations, float power, float bailout) {
+	V z = p;
+	S dr = 1.0f;
+	S r = 0.0f;
+
+	for (int i = 0; i < iterations; i++) {
+		r = length(z);
+		if (r > S(bailout)) break;
+
+		// convert to polar coords
+		S theta = acos(z.z / r);
+		S phi = atan2(z.y, z.x);
+		dr = pow(r, power - 1.0f) * S(power) * dr + S(1);
+
+		// scale and rotate point
+		S zr = pow(r, power);
+		theta = theta * S(power);
+		phi = phi * S(power);
+
+		// convert back to cartesian coords
+		z = V(sin(theta) * cos(phi), sin(phi) * sin(theta), cos(theta)) * zr;
+		z += p;
+	}
+
+	return S(0.5f) * log(r) * r / dr;
+}
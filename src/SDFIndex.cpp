@@ -0,0 +1,190 @@
+#include "SDFIndex.h"
+#include "MandelbulbDE.h"
+#include "Dual.h"
+
+
+void SDFIndex::build(const RenderScene& scene) {
+	this->scene = &scene;
+	unbounded.clear();
+	bounded.clear();
+	boxes.clear();
+
+	vector<Shape> shapes;
+	for (uint32_t i = 0; i < scene.sphereCenter.size(); i++) shapes.push_back({ SHAPE_SPHERE, i });
+	for (uint32_t i = 0; i < scene.planePosition.size(); i++) shapes.push_back({ SHAPE_PLANE, i });
+	for (uint32_t i = 0; i < scene.mengerCenter.size(); i++) shapes.push_back({ SHAPE_MENGER, i });
+	for (uint32_t i = 0; i < scene.bulbCenter.size(); i++) shapes.push_back({ SHAPE_MANDELBULB, i });
+
+	for (const Shape& shape : shapes) {
+		AABB box;
+		if (getBounds(shape, box)) {
+			bounded.push_back(shape);
+			boxes.push_back(box);
+		}
+		else {
+			unbounded.push_back(shape);
+		}
+	}
+	bvh.build(boxes);
+}
+
+// p is in world space, the sdf functions take it relative to the shape's position
+template <class V, class S>
+S SDFIndex::evaluate(const Shape& shape, const V& p) const {
+	uint32_t i = shape.index;
+	switch (shape.type) {
+	case SHAPE_SPHERE:
+		return sdfSphere(p - scene->sphereCenter[i], scene->sphereRadius[i]);
+	case SHAPE_PLANE:
+		return sdfPlane(p - scene->planePosition[i], scene->planePosition[i], scene->planeNormal[i],
+			scene->planeSize[i].x, scene->planeSize[i].y);
+	case SHAPE_MENGER:
+		return sdfMenger(p - scene->mengerCenter[i], glm::vec3(scene->mengerSize[i]), scene->mengerLevel[i]);
+	case SHAPE_MANDELBULB:
+		return mandelbulbDE(p - scene->bulbCenter[i], scene->bulbIterations[i], scene->bulbPower[i], scene->bulbBailout[i]);
+	}
+	return S(std::numeric_limits<float>::infinity());
+}
+
+// world space box around the surface of the shape's sdf, false if it is unbounded
+bool SDFIndex::getBounds(const Shape& shape, AABB& box) const {
+	uint32_t i = shape.index;
+	switch (shape.type) {
+	case SHAPE_SPHERE:
+		box = AABB(scene->sphereCenter[i] - glm::vec3(scene->sphereRadius[i]), scene->sphereCenter[i] + glm::vec3(scene->sphereRadius[i]));
+		return true;
+	case SHAPE_PLANE:
+		return false;   // the plane sdf is infinite
+	case SHAPE_MENGER:
+		box = AABB(scene->mengerCenter[i] - glm::vec3(scene->mengerSize[i] / 2), scene->mengerCenter[i] + glm::vec3(scene->mengerSize[i] / 2));
+		return true;
+	case SHAPE_MANDELBULB:
+		// for power >= 2 any point further than 2 from the center escapes
+		if (scene->bulbPower[i] < 2) return false;
+		box = AABB(scene->bulbCenter[i] - glm::vec3(2), scene->bulbCenter[i] + glm::vec3(2));
+		return true;
+	}
+	return false;
+}
+
+uint32_t SDFIndex::getMaterial(const Shape& shape) const {
+	switch (shape.type) {
+	case SHAPE_SPHERE: return scene->sphereMaterial[shape.index];
+	case SHAPE_PLANE: return scene->planeMaterial[shape.index];
+	case SHAPE_MENGER: return scene->mengerMaterial[shape.index];
+	case SHAPE_MANDELBULB: return scene->bulbMaterial[shape.index];
+	}
+	return 0;
+}
+
+const SDFIndex::Shape* SDFIndex::closest(const glm::vec3& p, float& best) const {
+	best = std::numeric_limits<float>::infinity();
+	const Shape* closestShape = NULL;
+
+	for (const Shape& shape : unbounded) {
+		float dist = evaluate(shape, p);
+		if (dist < best) {
+			best = dist;
+			closestShape = &shape;
+		}
+	}
+
+	bvh.nearest(p, best, [&](uint32_t k, float& closest) {
+		float bound = boxes[k].distance(p);
+		if (bound >= closest) return;
+
+		// far from the box its distance is a good enough lower bound for the shape
+		float dist = bound > margin ? bound : evaluate(bounded[k], p);
+		if (dist < closest) {
+			closest = dist;
+			closestShape = &bounded[k];
+		}
+	});
+
+	return closestShape;
+}
+
+float SDFIndex::distance(const glm::vec3& p, int& material) const {
+	float dist;
+	const Shape* shape = closest(p, dist);
+	if (shape) material = getMaterial(*shape);
+	return dist;
+}
+
+glm::vec3 SDFIndex::normal(const glm::vec3& p) const {
+	float dist;
+	const Shape* shape = closest(p, dist);
+	if (!shape) return glm::vec3(0, 1, 0);
+
+	// the scene sdf is the min over the shapes, its gradient is the closest one's
+	Dual d = evaluate(*shape, DualVec3::variable(p));
+	float len = glm::length(d.d);
+	return len > 0 ? d.d / len : glm::vec3(0, 1, 0);
+}
+
+void SDFIndex::distance(const glm::vec3* p, int count, float* dist, int* material) const {
+	const Shape* closestShape[8];
+	for (int k = 0; k < count; k++) {
+		dist[k] = std::numeric_limits<float>::infinity();
+		closestShape[k] = NULL;
+	}
+
+	for (const Shape& shape : unbounded) {
+		for (int k = 0; k < count; k++) {
+			float d = evaluate(shape, p[k]);
+			if (d < dist[k]) {
+				dist[k] = d;
+				closestShape[k] = &shape;
+			}
+		}
+	}
+
+	bvh.nearest(p, count, dist, [&](uint32_t index) {
+		const Shape& shape = bounded[index];
+
+		// points that need the real sdf, the others use the box like distance() does
+		int lanes[8];
+		int needed = 0;
+		for (int k = 0; k < count; k++) {
+			float bound = boxes[index].distance(p[k]);
+			if (bound >= dist[k]) continue;
+			if (bound > margin) {
+				dist[k] = bound;
+				closestShape[k] = &shape;
+			}
+			else {
+				lanes[needed++] = k;
+			}
+		}
+		if (needed == 0) return;
+
+		float d[8];
+		if (shape.type == SHAPE_MANDELBULB && needed > 1) {
+			// gather the points, unused lanes repeat the last one
+			uint32_t i = shape.index;
+			float x[8], y[8], z[8];
+			for (int n = 0; n < 8; n++) {
+				glm::vec3 q = p[lanes[glm::min(n, needed - 1)]] - scene->bulbCenter[i];
+				x[n] = q.x;
+				y[n] = q.y;
+				z[n] = q.z;
+			}
+			mandelbulbDE8(x, y, z, scene->bulbIterations[i], scene->bulbPower[i], scene->bulbBailout[i], d);
+		}
+		else {
+			for (int n = 0; n < needed; n++) d[n] = evaluate(shape, p[lanes[n]]);
+		}
+
+		for (int n = 0; n < needed; n++) {
+			int k = lanes[n];
+			if (d[n] < dist[k]) {
+				dist[k] = d[n];
+				closestShape[k] = &shape;
+			}
+		}
+	});
+
+	for (int k = 0; k < count; k++) {
+		if (closestShape[k]) material[k] = getMaterial(*closestShape[k]);
+	}
+}
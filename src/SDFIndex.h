@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ofMain.h"
+#include "RenderScene.h"
+#include "BVH.h"
+
+
+//  bounding volume index over the ray marched shapes of a RenderScene
+//
+//  a distance query only evaluates the sdf of shapes whose bounds are within margin
+//  of the sample point. shapes further away stand in with the distance to their box,
+//  which never overestimates the distance to the shape, so marching stays safe.
+//  shapes with unbounded sdfs (planes) are always evaluated. mandelbulbs use the fast
+//  estimator from MandelbulbDE.h. normals come from one evaluation of the closest
+//  shape's sdf with dual numbers (Dual.h), which carries the gradient along
+class SDFIndex {
+public:
+	void build(const RenderScene& scene);
+
+	// distance to the closest shape, material is set to that shape's material
+	float distance(const glm::vec3& p, int& material) const;
+
+	// distance() for up to 8 points at once, a mandelbulb near several of them is
+	// estimated for all of them in one 8 wide call. material[k] is only set when
+	// something was found
+	void distance(const glm::vec3* p, int count, float* dist, int* material) const;
+
+	// surface normal at p, the normalized gradient of the closest shape's sdf
+	glm::vec3 normal(const glm::vec3& p) const;
+
+	int boundedCount() const { return (int)bounded.size(); }
+
+	float margin = 0.1;     // evaluate the real sdf this close to a shape's box
+
+private:
+	enum ShapeType : uint32_t {
+		SHAPE_SPHERE,
+		SHAPE_PLANE,
+		SHAPE_MENGER,
+		SHAPE_MANDELBULB
+	};
+
+	struct Shape {
+		ShapeType type;
+		uint32_t index;         // into the scene's arrays for that type
+	};
+
+	template <class V, class S = typename V::value_type>
+	S evaluate(const Shape& shape, const V& p) const;
+	const Shape* closest(const glm::vec3& p, float& dist) const;
+	bool getBounds(const Shape& shape, AABB& box) const;
+	uint32_t getMaterial(const Shape& shape) const;
+
+	const RenderScene* scene = NULL;
+	vector<Shape> unbounded;
+	vector<Shape> bounded;      // bvh primitive -> shape
+	vector<AABB> boxes;         // bounds of the bvh primitives
+	BVH bvh;
+};
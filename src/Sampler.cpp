@@ -0,0 +1,247 @@
+#include "Sampler.h"
+
+
+static inline uint32_t reverseBits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+}
+
+// hash where every bit only depends on the bits below it (Laine & Karras 2011),
+// on the reversed bits that makes it an owen scramble: a random flip of every node
+// of the binary tree of intervals
+static inline uint32_t owenScramble(uint32_t x, uint32_t seed) {
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+// the first two sobol dimensions, the first is the van der corput sequence
+static inline uint32_t sobol0(uint32_t i) {
+	return reverseBits(i);
+}
+
+static inline uint32_t sobol1(uint32_t i) {
+	uint32_t r = 0;
+	for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1) {
+		if (i & 1) r ^= v;
+	}
+	return r;
+}
+
+// top 24 bits, so the float stays below 1
+static inline float toUnit(uint32_t x) {
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+
+// blue noise
+
+static const int blueNoiseSize = 64;    // power of 2
+
+// ranks of the pixels of a tile by void and cluster (Ulichney 1993), as values in [0, 1)
+static void voidAndCluster(float* values, unsigned int seed) {
+	const int size = blueNoiseSize;
+	const int n = size * size;
+	const float sigma = 1.5;
+
+	// gaussian energy a set pixel adds at an offset, wrapped around the tile
+	vector<float> kernel(n);
+	for (int dy = 0; dy < size; dy++) {
+		for (int dx = 0; dx < size; dx++) {
+			int wx = glm::min(dx, size - dx);
+			int wy = glm::min(dy, size - dy);
+			kernel[dy * size + dx] = expf(-(wx * wx + wy * wy) / (2 * sigma * sigma));
+		}
+	}
+
+	vector<uint8_t> pattern(n, 0);
+	vector<float> energy(n, 0);
+	auto set = [&](int p, bool on) {
+		pattern[p] = on;
+		float sign = on ? 1.0f : -1.0f;
+		int px = p % size, py = p / size;
+		for (int y = 0; y < size; y++) {
+			const float* k = &kernel[((y - py) & (size - 1)) * size];
+			for (int x = 0; x < size; x++) energy[y * size + x] += sign * k[(x - px) & (size - 1)];
+		}
+	};
+	auto tightestCluster = [&]() {
+		int best = -1;
+		for (int p = 0; p < n; p++) {
+			if (pattern[p] && (best < 0 || energy[p] > energy[best])) best = p;
+		}
+		return best;
+	};
+	auto largestVoid = [&]() {
+		int best = -1;
+		for (int p = 0; p < n; p++) {
+			if (!pattern[p] && (best < 0 || energy[p] < energy[best])) best = p;
+		}
+		return best;
+	};
+
+	// a tenth of the pixels at random, moved from the tightest clusters into the
+	// largest voids until that stops changing anything
+	PixelRandom rng;
+	rng.seed(seed, 0, 0);
+	int ones = n / 10;
+	for (int placed = 0; placed < ones;) {
+		int p = glm::min((int)(rng.next() * n), n - 1);
+		if (pattern[p]) continue;
+		set(p, true);
+		placed++;
+	}
+	for (int i = 0; i < n; i++) {
+		int cluster = tightestCluster();
+		set(cluster, false);
+		int hole = largestVoid();
+		set(hole, true);
+		if (hole == cluster) break;
+	}
+
+	// ranks below the initial pattern's count take clusters away, those above fill voids
+	vector<uint8_t> initialPattern = pattern;
+	vector<float> initialEnergy = energy;
+	vector<int> rank(n);
+	for (int r = ones - 1; r >= 0; r--) {
+		int cluster = tightestCluster();
+		set(cluster, false);
+		rank[cluster] = r;
+	}
+	pattern = initialPattern;
+	energy = initialEnergy;
+	for (int r = ones; r < n; r++) {
+		int hole = largestVoid();
+		set(hole, true);
+		rank[hole] = r;
+	}
+
+	for (int p = 0; p < n; p++) values[p] = (rank[p] + 0.5f) / n;
+}
+
+// two tiles, for the x and y shifts. built the first time a blue noise sampler is
+// used (about 0.1s), thread safe as a function static
+struct BlueNoiseTiles {
+	BlueNoiseTiles() {
+		voidAndCluster(values[0], 1);
+		voidAndCluster(values[1], 2);
+	}
+	float values[2][blueNoiseSize * blueNoiseSize];
+};
+
+static const BlueNoiseTiles& getBlueNoise() {
+	static BlueNoiseTiles tiles;
+	return tiles;
+}
+
+
+// sampler
+
+static int gcd(int a, int b) {
+	while (b) {
+		int r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+void Sampler::seed(SamplerType type, unsigned int seed, int x, int y) {
+	this->type = type;
+	seedValue = seed;
+	this->x = x;
+	this->y = y;
+	dimension = 0;
+	rng.seed(seed, x, y);
+}
+
+void Sampler::begin(int count, int gridWidth, int gridHeight) {
+	index = 0;
+	this->gridWidth = glm::max(gridWidth, 1);
+	this->gridHeight = glm::max(gridHeight, 1);
+	int cells = this->gridWidth * this->gridHeight;
+
+	// the cells are visited round robin with a golden ratio stride (made coprime with
+	// the cell count so it reaches them all), that way any prefix of the set, like the
+	// adaptive shadow probes, is spread over the whole light
+	stride = glm::max((int)(cells * 0.618f + 0.5f), 1);
+	while (gcd(stride, cells) != 1) stride++;
+
+	// blue noise uses the same points in every pixel, only the shift differs
+	unsigned int h = PixelRandom::hash(seedValue ^ PixelRandom::hash(dimension * 0x9e3779b9u));
+	if (type != SAMPLER_BLUE_NOISE) h = PixelRandom::hash(h ^ PixelRandom::hash(x * 73856093u ^ PixelRandom::hash(y * 19349663u)));
+	for (int k = 0; k < 3; k++) {
+		h = PixelRandom::hash(h + 0x9e3779b9u);
+		scramble[k] = h;
+	}
+
+	if (type == SAMPLER_BLUE_NOISE) {
+		// every set reads the tiles at its own offset
+		const int mask = blueNoiseSize - 1;
+		int tx = (x + (h & mask)) & mask;
+		int ty = (y + ((h >> 8) & mask)) & mask;
+		const BlueNoiseTiles& tiles = getBlueNoise();
+		shift = glm::vec2(tiles.values[0][ty * blueNoiseSize + tx], tiles.values[1][ty * blueNoiseSize + tx]);
+	}
+
+	dimension++;
+}
+
+glm::vec2 Sampler::next() {
+	switch (type) {
+	case SAMPLER_RANDOM:
+		return glm::vec2(rng.next(), rng.next());
+
+	case SAMPLER_STRATIFIED: {
+		int cells = gridWidth * gridHeight;
+		int cell = (int)((int64_t)(index++ % cells) * stride % cells);
+		int i = cell / gridHeight;
+		int j = cell % gridHeight;
+		float u = rng.next();
+		float v = rng.next();
+		return glm::vec2((i + u) / gridWidth, (j + v) / gridHeight);
+	}
+
+	case SAMPLER_SOBOL:
+	case SAMPLER_BLUE_NOISE: {
+		// shuffling the index as well keeps a prefix of any length well spread
+		uint32_t i = owenScramble((uint32_t)index++, scramble[0]);
+		glm::vec2 p(toUnit(owenScramble(sobol0(i), scramble[1])), toUnit(owenScramble(sobol1(i), scramble[2])));
+		if (type == SAMPLER_BLUE_NOISE) {
+			p += shift;
+			if (p.x >= 1) p.x -= 1;
+			if (p.y >= 1) p.y -= 1;
+		}
+		return p;
+	}
+	}
+	return glm::vec2(0.5);
+}
+
+const char* Sampler::getName(SamplerType type) {
+	switch (type) {
+	case SAMPLER_RANDOM: return "random";
+	case SAMPLER_STRATIFIED: return "stratified";
+	case SAMPLER_SOBOL: return "sobol";
+	case SAMPLER_BLUE_NOISE: return "bluenoise";
+	}
+	return "";
+}
+
+bool Sampler::parse(const string& name, SamplerType& type) {
+	for (SamplerType t : { SAMPLER_RANDOM, SAMPLER_STRATIFIED, SAMPLER_SOBOL, SAMPLER_BLUE_NOISE }) {
+		if (name == getName(t)) {
+			type = t;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Primitives.h"
+
+
+//  2d sample points for area lights
+//
+//  reseeded for every pixel like PixelRandom, so the same seed gives the same image
+//  whichever thread renders a pixel. each begin() starts a new set of points (one per
+//  light), with its own scramble so the lights' samples aren't correlated
+//
+//    random       independent uniform points
+//    stratified   one jittered point per cell of the light's grid (what area lights
+//                 always did), the cells visited in a spread out order
+//    sobol        the first two dimensions of the sobol sequence, owen scrambled per
+//                 pixel with a hash (Burley 2020), a (0, 2) net for power of 2 counts
+//    blue noise   the same sobol points in every pixel, shifted (mod 1) by a 64 x 64
+//                 blue noise tile over the screen. neighbouring pixels get opposite
+//                 errors, fine grain instead of blotches. that pays off with 1 - 4
+//                 samples per light, above that it is no better than sobol
+enum SamplerType {
+	SAMPLER_RANDOM,
+	SAMPLER_STRATIFIED,
+	SAMPLER_SOBOL,
+	SAMPLER_BLUE_NOISE
+};
+
+class Sampler {
+public:
+	void seed(SamplerType type, unsigned int seed, int x, int y);
+
+	// start a set of count points, stratified over a gridWidth x gridHeight grid
+	void begin(int count, int gridWidth, int gridHeight);
+
+	// next point of the set in [0, 1)^2
+	glm::vec2 next();
+
+	static const char* getName(SamplerType type);
+	static bool parse(const string& name, SamplerType& type);
+
+	PixelRandom rng;
+
+private:
+	SamplerType type = SAMPLER_SOBOL;
+	unsigned int seedValue = 0;
+	int x = 0, y = 0;
+	int dimension = 0;          // sets started since seed()
+
+	// current set
+	int index = 0;
+	int gridWidth = 1, gridHeight = 1;
+	int stride = 1;             // stratified: cells between consecutive points
+	unsigned int scramble[3];   // index shuffle, x and y scrambles
+	glm::vec2 shift;            // blue noise offset
+};
@@ -0,0 +1,616 @@
+#include "SceneFile.h"
+#include <fstream>
+
+
+static_assert(sizeof(MaterialRecord) == 64, "binary scene layout changed");
+static_assert(sizeof(SphereRecord) == 20, "binary scene layout changed");
+static_assert(sizeof(PlaneRecord) == 36, "binary scene layout changed");
+static_assert(sizeof(MengerRecord) == 24, "binary scene layout changed");
+static_assert(sizeof(MandelbulbRecord) == 28, "binary scene layout changed");
+static_assert(sizeof(LightRecord) == 40, "binary scene layout changed");
+static_assert(sizeof(CameraRecord) == 40, "binary scene layout changed");
+
+
+// scene data
+
+void SceneData::clear() {
+	file.close();
+	camera = CameraRecord();
+	hasCamera = false;
+
+	ownedMaterials.clear();
+	ownedSpheres.clear();
+	ownedPlanes.clear();
+	ownedMengers.clear();
+	ownedMandelbulbs.clear();
+	ownedLights.clear();
+	materialIndex.clear();
+	updateSpans();
+}
+
+uint32_t SceneData::addMaterial(const MaterialRecord& m) {
+	makeOwned();
+
+	string key((const char*)&m, sizeof(MaterialRecord));
+	auto found = materialIndex.find(key);
+	if (found != materialIndex.end()) return found->second;
+
+	uint32_t index = (uint32_t)ownedMaterials.size();
+	ownedMaterials.push_back(m);
+	materialIndex[key] = index;
+	updateSpans();
+	return index;
+}
+
+void SceneData::makeOwned() {
+	if (!file.isOpen()) return;
+
+	ownedMaterials.assign(materials.begin(), materials.end());
+	ownedSpheres.assign(spheres.begin(), spheres.end());
+	ownedPlanes.assign(planes.begin(), planes.end());
+	ownedMengers.assign(mengers.begin(), mengers.end());
+	ownedMandelbulbs.assign(mandelbulbs.begin(), mandelbulbs.end());
+	ownedLights.assign(lights.begin(), lights.end());
+
+	materialIndex.clear();
+	for (uint32_t i = 0; i < ownedMaterials.size(); i++) {
+		materialIndex[string((const char*)&ownedMaterials[i], sizeof(MaterialRecord))] = i;
+	}
+
+	file.close();
+	updateSpans();
+}
+
+template <class T>
+static void setSpan(RecordSpan<T>& span, const vector<T>& v) {
+	span.data = v.data();
+	span.count = v.size();
+}
+
+void SceneData::updateSpans() {
+	setSpan(materials, ownedMaterials);
+	setSpan(spheres, ownedSpheres);
+	setSpan(planes, ownedPlanes);
+	setSpan(mengers, ownedMengers);
+	setSpan(mandelbulbs, ownedMandelbulbs);
+	setSpan(lights, ownedLights);
+}
+
+
+// load / save
+
+bool SceneFile::load(const string& path, SceneData& data) {
+	return isBinaryPath(path) ? loadBinary(path, data) : loadText(path, data);
+}
+
+bool SceneFile::save(const string& path, const SceneData& data) {
+	return isBinaryPath(path) ? saveBinary(path, data) : saveText(path, data);
+}
+
+
+// record ranges, mostly the ones the gui allows. larger values would hang the marcher
+// (menger levels, bulb iterations) or allocate without bound (light samples), 0 tiles divide by 0
+
+static bool inRange(const MaterialRecord& m) { return m.numTiles >= 1; }
+static bool inRange(const MengerRecord& m) { return m.level >= 0 && m.level <= 10; }
+static bool inRange(const MandelbulbRecord& m) { return m.iterations >= 1 && m.iterations <= 20; }
+static bool inRange(const LightRecord& l) {
+	if (l.type > LIGHT_AREA || l.shadowMode > (uint32_t)SHADOW_PENUMBRA) return false;
+	return l.type == LIGHT_POINT || (l.divsWidth >= 0 && l.divsWidth <= 20 &&
+		l.divsHeight >= 0 && l.divsHeight <= 20 && l.samples >= 1 && l.samples <= 5);
+}
+
+template <class T>
+static bool inRange(const RecordSpan<T>& span) {
+	for (const T& record : span) {
+		if (!inRange(record)) return false;
+	}
+	return true;
+}
+
+
+// text format
+
+static string formatFloat(float f) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.9g", f);
+	return buf;
+}
+
+static string formatVec(const glm::vec3& v) {
+	return formatFloat(v.x) + "," + formatFloat(v.y) + "," + formatFloat(v.z);
+}
+
+static string formatColor(const uint8_t* c) {
+	return ofToString((int)c[0]) + "," + ofToString((int)c[1]) + "," + ofToString((int)c[2]) + "," + ofToString((int)c[3]);
+}
+
+static string formatMaterial(const SceneData& data, uint32_t index) {
+	if (index >= data.materials.size()) return "";
+	const MaterialRecord& m = data.materials[index];
+	return " diffuse=" + formatColor(m.diffuse) + " specular=" + formatColor(m.specular) +
+		" tiles=" + ofToString(m.numTiles) + " texture=\"" + string(m.texture, strnlen(m.texture, sizeof(m.texture))) + "\"";
+}
+
+bool SceneFile::saveText(const string& path, const SceneData& data) {
+	ofstream out(path);
+	if (!out) {
+		printf("could not write scene %s\n", path.c_str());
+		return false;
+	}
+
+	out << "# RayTracer scene" << endl;
+	if (data.hasCamera) {
+		const CameraRecord& c = data.camera;
+		out << "camera eye=" << formatVec(c.eye) << " target=" << formatVec(c.target)
+			<< " up=" << formatVec(c.up) << " fov=" << formatFloat(c.fov) << endl;
+	}
+	for (const LightRecord& l : data.lights) {
+		if (l.type == LIGHT_AREA) {
+			out << "arealight position=" << formatVec(l.position) << " intensity=" << formatFloat(l.intensity)
+				<< " width=" << formatFloat(l.width) << " height=" << formatFloat(l.height)
+				<< " divs=" << l.divsWidth << "," << l.divsHeight << " samples=" << l.samples
+				<< " shadows=" << (l.shadowMode == SHADOW_PENUMBRA ? "penumbra" : "sampled") << endl;
+		}
+		else {
+			out << "pointlight position=" << formatVec(l.position) << " intensity=" << formatFloat(l.intensity) << endl;
+		}
+	}
+	for (const PlaneRecord& p : data.planes) {
+		out << "plane position=" << formatVec(p.position) << " normal=" << formatVec(p.normal)
+			<< " width=" << formatFloat(p.width) << " height=" << formatFloat(p.height)
+			<< formatMaterial(data, p.material) << endl;
+	}
+	for (const SphereRecord& s : data.spheres) {
+		out << "sphere position=" << formatVec(s.position) << " radius=" << formatFloat(s.radius)
+			<< formatMaterial(data, s.material) << endl;
+	}
+	for (const MengerRecord& m : data.mengers) {
+		out << "menger position=" << formatVec(m.position) << " size=" << formatFloat(m.size)
+			<< " level=" << m.level << formatMaterial(data, m.material) << endl;
+	}
+	for (const MandelbulbRecord& m : data.mandelbulbs) {
+		out << "mandelbulb position=" << formatVec(m.position) << " iterations=" << m.iterations
+			<< " power=" << formatFloat(m.power) << " bailout=" << formatFloat(m.bailout)
+			<< formatMaterial(data, m.material) << endl;
+	}
+	return (bool)out;
+}
+
+// split "type key=value key="quoted value"" into the type and its fields
+static bool parseFields(const string& line, string& type, map<string, string>& fields) {
+	size_t i = 0;
+	auto skipSpace = [&] { while (i < line.size() && isspace((unsigned char)line[i])) i++; };
+
+	skipSpace();
+	while (i < line.size() && !isspace((unsigned char)line[i])) type += line[i++];
+
+	for (;;) {
+		skipSpace();
+		if (i >= line.size()) return true;
+
+		size_t eq = line.find('=', i);
+		if (eq == string::npos) return false;
+		string key = line.substr(i, eq - i);
+		i = eq + 1;
+
+		string value;
+		if (i < line.size() && line[i] == '"') {
+			size_t close = line.find('"', i + 1);
+			if (close == string::npos) return false;
+			value = line.substr(i + 1, close - i - 1);
+			i = close + 1;
+		}
+		else {
+			while (i < line.size() && !isspace((unsigned char)line[i])) value += line[i++];
+		}
+		fields[key] = value;
+	}
+}
+
+static bool parseFloats(const string& s, float* out, int n) {
+	vector<string> parts = ofSplitString(s, ",", true, true);
+	if (parts.size() != n) return false;
+	for (int i = 0; i < n; i++) out[i] = ofToFloat(parts[i]);
+	return true;
+}
+
+// field readers leave the default in place when a field is missing
+struct FieldReader {
+	const map<string, string>& fields;
+	bool ok = true;
+
+	bool has(const string& key) { return fields.count(key) > 0; }
+	void get(const string& key, float& f) { if (has(key)) f = ofToFloat(fields.at(key)); }
+	void get(const string& key, int32_t& i) { if (has(key)) i = ofToInt(fields.at(key)); }
+	void get(const string& key, glm::vec3& v) {
+		if (has(key)) ok &= parseFloats(fields.at(key), &v[0], 3);
+	}
+	void get(const string& key, uint8_t* color) {
+		if (!has(key)) return;
+		vector<string> parts = ofSplitString(fields.at(key), ",", true, true);
+		if (parts.size() < 3 || parts.size() > 4) { ok = false; return; }
+		for (int i = 0; i < 4; i++) {
+			color[i] = i < parts.size() ? (uint8_t)ofClamp(ofToInt(parts[i]), 0, 255) : 255;
+		}
+	}
+};
+
+static MaterialRecord defaultMaterial() {
+	MaterialRecord m;
+	memset(&m, 0, sizeof(m));
+	m.diffuse[0] = m.diffuse[1] = m.diffuse[2] = m.diffuse[3] = 255;
+	m.specular[0] = m.specular[1] = m.specular[2] = m.specular[3] = 255;
+	m.numTiles = 1;
+	strncpy(m.texture, "None", sizeof(m.texture) - 1);
+	return m;
+}
+
+static uint32_t readMaterial(FieldReader& r, SceneData& data) {
+	MaterialRecord m = defaultMaterial();
+	r.get("diffuse", m.diffuse);
+	r.get("specular", m.specular);
+	r.get("tiles", m.numTiles);
+	if (r.has("texture")) {
+		memset(m.texture, 0, sizeof(m.texture));
+		strncpy(m.texture, r.fields.at("texture").c_str(), sizeof(m.texture) - 1);
+	}
+	r.ok &= inRange(m);
+	return data.addMaterial(m);
+}
+
+bool SceneFile::loadText(const string& path, SceneData& data) {
+	ifstream in(path);
+	if (!in) {
+		printf("could not open scene %s\n", path.c_str());
+		return false;
+	}
+
+	data.clear();
+	string line;
+	int lineNumber = 0;
+	while (getline(in, line)) {
+		lineNumber++;
+		line = ofTrim(line);
+		if (line.empty() || line[0] == '#') continue;
+
+		string type;
+		map<string, string> fields;
+		if (!parseFields(line, type, fields)) {
+			printf("%s:%d: could not parse line\n", path.c_str(), lineNumber);
+			return false;
+		}
+		FieldReader r{ fields };
+
+		if (type == "camera") {
+			r.get("eye", data.camera.eye);
+			r.get("target", data.camera.target);
+			r.get("up", data.camera.up);
+			r.get("fov", data.camera.fov);
+			data.hasCamera = true;
+		}
+		else if (type == "pointlight" || type == "arealight") {
+			LightRecord l = { LIGHT_POINT, glm::vec3(0, 10, 0), 10, 5, 5, 5, 5, 1, SHADOW_SAMPLED };
+			if (type == "arealight") {
+				l.type = LIGHT_AREA;
+				float divs[2] = { 5, 5 };
+				if (r.has("divs")) r.ok &= parseFloats(fields.at("divs"), divs, 2);
+				l.divsWidth = (int32_t)divs[0];
+				l.divsHeight = (int32_t)divs[1];
+			}
+			r.get("position", l.position);
+			r.get("intensity", l.intensity);
+			r.get("width", l.width);
+			r.get("height", l.height);
+			r.get("samples", l.samples);
+			if (r.has("shadows")) {
+				const string& mode = fields.at("shadows");
+				if (mode == "penumbra") l.shadowMode = SHADOW_PENUMBRA;
+				else if (mode != "sampled") r.ok = false;
+			}
+			r.ok &= inRange(l);
+			data.addLight(l);
+		}
+		else if (type == "plane") {
+			PlaneRecord p = { glm::vec3(0), glm::vec3(0, 1, 0), 20, 20, 0 };
+			r.get("position", p.position);
+			r.get("normal", p.normal);
+			r.get("width", p.width);
+			r.get("height", p.height);
+			p.material = readMaterial(r, data);
+			data.addPlane(p);
+		}
+		else if (type == "sphere") {
+			SphereRecord s = { glm::vec3(0), 1, 0 };
+			r.get("position", s.position);
+			r.get("radius", s.radius);
+			s.material = readMaterial(r, data);
+			data.addSphere(s);
+		}
+		else if (type == "menger") {
+			MengerRecord m = { glm::vec3(0), 2, 1, 0 };
+			r.get("position", m.position);
+			r.get("size", m.size);
+			r.get("level", m.level);
+			r.ok &= inRange(m);
+			m.material = readMaterial(r, data);
+			data.addMenger(m);
+		}
+		else if (type == "mandelbulb") {
+			MandelbulbRecord m = { glm::vec3(0), 5, 3, 4, 0 };
+			r.get("position", m.position);
+			r.get("iterations", m.iterations);
+			r.get("power", m.power);
+			r.get("bailout", m.bailout);
+			r.ok &= inRange(m);
+			m.material = readMaterial(r, data);
+			data.addMandelbulb(m);
+		}
+		else {
+			printf("%s:%d: unknown object type '%s'\n", path.c_str(), lineNumber, type.c_str());
+			return false;
+		}
+
+		if (!r.ok) {
+			printf("%s:%d: bad value\n", path.c_str(), lineNumber);
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// binary format
+
+enum SectionType : uint32_t {
+	SECTION_CAMERA = 1,
+	SECTION_MATERIALS,
+	SECTION_SPHERES,
+	SECTION_PLANES,
+	SECTION_MENGERS,
+	SECTION_MANDELBULBS,
+	SECTION_LIGHTS
+};
+
+struct BinaryHeader {
+	char magic[4];              // "RTSB"
+	uint32_t version;
+	uint32_t sectionCount;
+	uint32_t reserved;
+};
+
+struct BinarySection {
+	uint32_t type;
+	uint32_t count;
+	uint64_t offset;            // from the start of the file
+};
+
+static const uint32_t binaryVersion = 2;      // 2: lights have a shadow mode
+
+bool SceneFile::saveBinary(const string& path, const SceneData& data) {
+	struct Block { uint32_t type; uint32_t count; const void* bytes; size_t size; };
+	vector<Block> blocks;
+	if (data.hasCamera) blocks.push_back({ SECTION_CAMERA, 1, &data.camera, sizeof(CameraRecord) });
+	blocks.push_back({ SECTION_MATERIALS, (uint32_t)data.materials.size(), data.materials.data, data.materials.size() * sizeof(MaterialRecord) });
+	blocks.push_back({ SECTION_SPHERES, (uint32_t)data.spheres.size(), data.spheres.data, data.spheres.size() * sizeof(SphereRecord) });
+	blocks.push_back({ SECTION_PLANES, (uint32_t)data.planes.size(), data.planes.data, data.planes.size() * sizeof(PlaneRecord) });
+	blocks.push_back({ SECTION_MENGERS, (uint32_t)data.mengers.size(), data.mengers.data, data.mengers.size() * sizeof(MengerRecord) });
+	blocks.push_back({ SECTION_MANDELBULBS, (uint32_t)data.mandelbulbs.size(), data.mandelbulbs.data, data.mandelbulbs.size() * sizeof(MandelbulbRecord) });
+	blocks.push_back({ SECTION_LIGHTS, (uint32_t)data.lights.size(), data.lights.data, data.lights.size() * sizeof(LightRecord) });
+
+	BinaryHeader header = { { 'R', 'T', 'S', 'B' }, binaryVersion, (uint32_t)blocks.size(), 0 };
+
+	// lay out the arrays after the section table, each 16 byte aligned
+	vector<BinarySection> sections;
+	uint64_t offset = sizeof(BinaryHeader) + blocks.size() * sizeof(BinarySection);
+	for (const Block& b : blocks) {
+		offset = (offset + 15) & ~(uint64_t)15;
+		sections.push_back({ b.type, b.count, offset });
+		offset += b.size;
+	}
+
+	// the old file may still be mapped, even by data itself, see MappedFile::replace()
+	string tempPath = MappedFile::tempPath(path);
+	ofstream out(tempPath, ios::binary);
+	if (!out) {
+		printf("could not write scene %s\n", path.c_str());
+		return false;
+	}
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)sections.data(), sections.size() * sizeof(BinarySection));
+
+	const char zeros[16] = {};
+	for (size_t i = 0; i < blocks.size(); i++) {
+		uint64_t pos = (uint64_t)out.tellp();
+		out.write(zeros, sections[i].offset - pos);
+		if (blocks[i].size) out.write((const char*)blocks[i].bytes, blocks[i].size);
+	}
+	out.close();
+	if (!out || !MappedFile::replace(tempPath, path)) {
+		if (!out) ofFile::removeFile(tempPath, false);
+		printf("could not write scene %s\n", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+template <class T>
+static bool mapSection(const MappedFile& file, const BinarySection& s, RecordSpan<T>& span) {
+	if (s.offset % alignof(T) != 0 || s.offset > file.size() ||
+		(file.size() - s.offset) / sizeof(T) < s.count) {
+		return false;
+	}
+	span.data = (const T*)(file.data() + s.offset);
+	span.count = s.count;
+	return true;
+}
+
+bool SceneFile::loadBinary(const string& path, SceneData& data) {
+	data.clear();
+	if (!data.file.open(path)) {
+		printf("could not open scene %s\n", path.c_str());
+		return false;
+	}
+
+	const MappedFile& file = data.file;
+	const BinaryHeader* header = (const BinaryHeader*)file.data();
+	if (file.size() < sizeof(BinaryHeader) || memcmp(header->magic, "RTSB", 4) != 0 ||
+		header->version != binaryVersion ||
+		(file.size() - sizeof(BinaryHeader)) / sizeof(BinarySection) < header->sectionCount) {
+		printf("%s is not a binary scene (version %d)\n", path.c_str(), binaryVersion);
+		data.clear();
+		return false;
+	}
+
+	// records are used straight from the mapping, nothing is copied
+	const BinarySection* sections = (const BinarySection*)(file.data() + sizeof(BinaryHeader));
+	bool ok = true;
+	for (uint32_t i = 0; i < header->sectionCount && ok; i++) {
+		const BinarySection& s = sections[i];
+		switch (s.type) {
+		case SECTION_CAMERA: {
+			RecordSpan<CameraRecord> camera;
+			ok = mapSection(file, s, camera) && camera.size() == 1;
+			if (ok) {
+				data.camera = camera[0];
+				data.hasCamera = true;
+			}
+			break;
+		}
+		case SECTION_MATERIALS: ok = mapSection(file, s, data.materials); break;
+		case SECTION_SPHERES: ok = mapSection(file, s, data.spheres); break;
+		case SECTION_PLANES: ok = mapSection(file, s, data.planes); break;
+		case SECTION_MENGERS: ok = mapSection(file, s, data.mengers); break;
+		case SECTION_MANDELBULBS: ok = mapSection(file, s, data.mandelbulbs); break;
+		case SECTION_LIGHTS: ok = mapSection(file, s, data.lights); break;
+		default: break;     // skip sections from newer versions
+		}
+	}
+
+	if (!ok) {
+		printf("%s: corrupt section table\n", path.c_str());
+		data.clear();
+		return false;
+	}
+
+	// the records are used as they are, so values outside what the gui allows are rejected
+	if (!inRange(data.materials) || !inRange(data.mengers) || !inRange(data.mandelbulbs) || !inRange(data.lights)) {
+		printf("%s: record out of range\n", path.c_str());
+		data.clear();
+		return false;
+	}
+	return true;
+}
+
+
+// scene objects <-> records
+
+static MaterialRecord materialOf(SceneObject* obj) {
+	MaterialRecord m = defaultMaterial();
+	for (int i = 0; i < 4; i++) {
+		m.diffuse[i] = obj->diffuseColor[i];
+		m.specular[i] = obj->specularColor[i];
+	}
+	m.numTiles = obj->numTiles;
+	memset(m.texture, 0, sizeof(m.texture));
+	strncpy(m.texture, obj->textureName.c_str(), sizeof(m.texture) - 1);
+	return m;
+}
+
+void SceneFile::capture(const vector<SceneObject*>& scene, const vector<Light*>& lights, SceneData& data) {
+	bool hasCamera = data.hasCamera;
+	CameraRecord camera = data.camera;
+	data.clear();
+	data.hasCamera = hasCamera;
+	data.camera = camera;
+
+	for (SceneObject* obj : scene) {
+		uint32_t material = data.addMaterial(materialOf(obj));
+
+		// check the most derived types first
+		if (MengerSponge* m = dynamic_cast<MengerSponge*>(obj)) {
+			data.addMenger({ m->position, m->dimensions.x, m->level, material });
+		}
+		else if (Mandelbulb* m = dynamic_cast<Mandelbulb*>(obj)) {
+			data.addMandelbulb({ m->position, m->iterations, m->power, m->bailout, material });
+		}
+		else if (Sphere* s = dynamic_cast<Sphere*>(obj)) {
+			data.addSphere({ s->position, s->radius, material });
+		}
+		else if (Plane* p = dynamic_cast<Plane*>(obj)) {
+			data.addPlane({ p->position, p->normal, p->width, p->height, material });
+		}
+	}
+
+	for (Light* light : lights) {
+		if (AreaLight* a = dynamic_cast<AreaLight*>(light)) {
+			data.addLight({ LIGHT_AREA, a->position, a->intensity, a->width, a->height,
+				a->nDivsWidth, a->nDivsHeight, a->nSamples, a->shadowMode });
+		}
+		else if (dynamic_cast<PointLight*>(light)) {
+			data.addLight({ LIGHT_POINT, light->position, light->intensity, 0, 0, 0, 0, 1, light->shadowMode });
+		}
+	}
+}
+
+static ofColor diffuseOf(const SceneData& data, uint32_t index) {
+	if (index >= data.materials.size()) return ofColor::white;
+	const uint8_t* c = data.materials[index].diffuse;
+	return ofColor(c[0], c[1], c[2], c[3]);
+}
+
+// diffuse color goes through the constructors so the gui panels pick it up
+static void applyMaterial(const SceneData& data, uint32_t index, SceneObject* obj) {
+	if (index >= data.materials.size()) return;
+	const MaterialRecord& m = data.materials[index];
+	obj->specularColor = ofColor(m.specular[0], m.specular[1], m.specular[2], m.specular[3]);
+	obj->numTiles = m.numTiles;
+	obj->nTiles = m.numTiles;
+	obj->textureName = string(m.texture, strnlen(m.texture, sizeof(m.texture)));
+}
+
+void SceneFile::instantiate(const SceneData& data, vector<SceneObject*>& scene, vector<Light*>& lights) {
+	for (const PlaneRecord& p : data.planes) {
+		Plane* plane = new Plane(p.position, p.normal, diffuseOf(data, p.material), p.width, p.height);
+		applyMaterial(data, p.material, plane);
+		scene.push_back(plane);
+	}
+	for (const SphereRecord& s : data.spheres) {
+		Sphere* sphere = new Sphere(s.position, s.radius, diffuseOf(data, s.material));
+		applyMaterial(data, s.material, sphere);
+		scene.push_back(sphere);
+	}
+	for (const MengerRecord& m : data.mengers) {
+		MengerSponge* menger = new MengerSponge(m.position, diffuseOf(data, m.material), m.level, m.size);
+		applyMaterial(data, m.material, menger);
+		scene.push_back(menger);
+	}
+	for (const MandelbulbRecord& m : data.mandelbulbs) {
+		Mandelbulb* bulb = new Mandelbulb(m.position, diffuseOf(data, m.material), m.iterations, m.power, m.bailout);
+		applyMaterial(data, m.material, bulb);
+		scene.push_back(bulb);
+	}
+	instantiateLights(data, lights);
+}
+
+void SceneFile::instantiateLights(const SceneData& data, vector<Light*>& lights) {
+	for (const LightRecord& l : data.lights) {
+		if (l.type == LIGHT_AREA) {
+			AreaLight* area = new AreaLight(l.position, l.intensity, l.width, l.height, l.divsWidth, l.divsHeight, l.samples);
+
+			// the constructor only takes whole number sizes
+			area->width = l.width;
+			area->height = l.height;
+			area->alWidth = l.width;
+			area->alHeight = l.height;
+			area->shadowMode = (ShadowMode)l.shadowMode;
+			area->penumbraShadows = l.shadowMode == SHADOW_PENUMBRA;
+			lights.push_back(area);
+		}
+		else {
+			PointLight* point = new PointLight(l.position, l.intensity);
+			point->shadowMode = (ShadowMode)l.shadowMode;
+			lights.push_back(point);
+		}
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Primitives.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <unordered_map>
+
+
+//  plain scene records
+//  these are also the on-disk layout of the binary scene format (little endian),
+//  so a mapped .rtsb file can be used in place without parsing or constructors
+
+struct MaterialRecord {
+	uint8_t diffuse[4];         // rgba
+	uint8_t specular[4];
+	int32_t numTiles;
+	char texture[52];           // texture set name, "None" = untextured
+};
+
+struct SphereRecord {
+	glm::vec3 position;
+	float radius;
+	uint32_t material;
+};
+
+struct PlaneRecord {
+	glm::vec3 position;
+	glm::vec3 normal;
+	float width, height;
+	uint32_t material;
+};
+
+struct MengerRecord {
+	glm::vec3 position;
+	float size;
+	int32_t level;
+	uint32_t material;
+};
+
+struct MandelbulbRecord {
+	glm::vec3 position;
+	int32_t iterations;
+	float power;
+	float bailout;
+	uint32_t material;
+};
+
+enum LightType : uint32_t {
+	LIGHT_POINT = 0,
+	LIGHT_AREA = 1
+};
+
+struct LightRecord {
+	uint32_t type;
+	glm::vec3 position;
+	float intensity;
+	float width, height;            // area lights only
+	int32_t divsWidth, divsHeight, samples;
+	uint32_t shadowMode;            // ShadowMode
+};
+
+struct CameraRecord {
+	glm::vec3 eye = glm::vec3(0, 0, 10);
+	glm::vec3 target = glm::vec3(0, 0, 0);
+	glm::vec3 up = glm::vec3(0, 1, 0);
+	float fov = 60;
+};
+
+
+// read-only view of an array of records
+template <class T>
+struct RecordSpan {
+	const T* begin() const { return data; }
+	const T* end() const { return data + count; }
+	const T& operator[](size_t i) const { return data[i]; }
+	size_t size() const { return count; }
+
+	const T* data = nullptr;
+	size_t count = 0;
+};
+
+
+//  a scene as flat arrays of records
+//  records live either in the scene's own vectors (built in code or parsed from text)
+//  or directly in a memory mapped binary file, the spans hide the difference
+class SceneData {
+public:
+	SceneData() {}
+	SceneData(const SceneData&) = delete;
+	SceneData& operator=(const SceneData&) = delete;
+
+	void clear();
+
+	// add records, identical materials are shared
+	uint32_t addMaterial(const MaterialRecord& m);
+	void addSphere(const SphereRecord& s) { makeOwned(); ownedSpheres.push_back(s); updateSpans(); }
+	void addPlane(const PlaneRecord& p) { makeOwned(); ownedPlanes.push_back(p); updateSpans(); }
+	void addMenger(const MengerRecord& m) { makeOwned(); ownedMengers.push_back(m); updateSpans(); }
+	void addMandelbulb(const MandelbulbRecord& m) { makeOwned(); ownedMandelbulbs.push_back(m); updateSpans(); }
+	void addLight(const LightRecord& l) { makeOwned(); ownedLights.push_back(l); updateSpans(); }
+
+	bool isMapped() const { return file.isOpen(); }
+	size_t objectCount() const { return spheres.size() + planes.size() + mengers.size() + mandelbulbs.size(); }
+
+	CameraRecord camera;
+	bool hasCamera = false;
+
+	RecordSpan<MaterialRecord> materials;
+	RecordSpan<SphereRecord> spheres;
+	RecordSpan<PlaneRecord> planes;
+	RecordSpan<MengerRecord> mengers;
+	RecordSpan<MandelbulbRecord> mandelbulbs;
+	RecordSpan<LightRecord> lights;
+
+private:
+	friend class SceneFile;
+
+	void makeOwned();       // copy mapped records into the vectors before editing
+	void updateSpans();
+
+	vector<MaterialRecord> ownedMaterials;
+	vector<SphereRecord> ownedSpheres;
+	vector<PlaneRecord> ownedPlanes;
+	vector<MengerRecord> ownedMengers;
+	vector<MandelbulbRecord> ownedMandelbulbs;
+	vector<LightRecord> ownedLights;
+	unordered_map<string, uint32_t> materialIndex;
+
+	MappedFile file;
+};
+
+
+//  scene serialization
+//
+//  text format (.scene): one object per line, "type key=value ...", for example
+//    camera eye=0,0,10 target=0,0,0 up=0,1,0 fov=60
+//    sphere position=0,1,-2 radius=2 diffuse=173,216,230 texture="Marble Floor" tiles=2
+//    pointlight position=5,8,0 intensity=200
+//    arealight position=0,10,0 intensity=10 width=5 height=5 divs=10,10 samples=1 shadows=penumbra
+//
+//  binary format (.rtsb): header, section table, then the record arrays aligned to
+//  16 bytes. loading maps the file and points the scene's spans into it
+class SceneFile {
+public:
+	// format is picked from the extension, .rtsb = binary, anything else = text
+	static bool load(const string& path, SceneData& data);
+	static bool save(const string& path, const SceneData& data);
+
+	static bool loadText(const string& path, SceneData& data);
+	static bool saveText(const string& path, const SceneData& data);
+	static bool loadBinary(const string& path, SceneData& data);
+	static bool saveBinary(const string& path, const SceneData& data);
+
+	// convert between records and editable scene objects
+	static void capture(const vector<SceneObject*>& scene, const vector<Light*>& lights, SceneData& data);
+	static void instantiate(const SceneData& data, vector<SceneObject*>& scene, vector<Light*>& lights);
+
+	// just the lights, for rendering the records without objects (RenderScene::build(SceneData))
+	static void instantiateLights(const SceneData& data, vector<Light*>& lights);
+
+	static bool isBinaryPath(const string& path) { return ofToLower(ofFilePath::getFileExt(path)) == "rtsb"; }
+};
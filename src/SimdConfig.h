@@ -0,0 +1,20 @@
+#pragma once
+
+//  which simd kernels can be compiled in
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PACKET_SSE 1
+#include <emmintrin.h>
+#endif
+
+// avx2 kernels are compiled in on any x86 compiler and only used after a cpu check
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PACKET_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
@@ -0,0 +1,196 @@
+#include "TextureMap.h"
+#include <fstream>
+
+
+void TextureMap::clear() {
+	levels.clear();
+	texels = nullptr;
+	texelBytes = 0;
+	owned.clear();
+	file.close();
+}
+
+// channel c of pixel i, gray images repeat their one channel
+static inline uint8_t channel(const ofPixels& pixels, size_t i, int c) {
+	int channels = pixels.getNumChannels();
+	return pixels.getData()[i * channels + (channels >= 3 ? c : 0)];
+}
+
+void TextureMap::build(const ofPixels& diffuse, const ofPixels& specular) {
+	clear();
+	int width = diffuse.getWidth();
+	int height = diffuse.getHeight();
+	if (width == 0 || height == 0) return;
+
+	// full size level as plain rows, alpha is the specular brightness (ofColor::getBrightness())
+	vector<uint8_t> level(width * height * 4);
+	int specWidth = specular.getWidth();
+	int specHeight = specular.getHeight();
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t i = (size_t)y * width + x;
+			uint8_t* t = &level[i * 4];
+			t[0] = channel(diffuse, i, 0);
+			t[1] = channel(diffuse, i, 1);
+			t[2] = channel(diffuse, i, 2);
+			t[3] = 0;
+			if (specWidth > 0 && specHeight > 0) {
+				size_t s = (size_t)(y * specHeight / height) * specWidth + x * specWidth / width;
+				t[3] = glm::max(channel(specular, s, 0), glm::max(channel(specular, s, 1), channel(specular, s, 2)));
+			}
+		}
+	}
+
+	while (true) {
+		// swizzle the level into blocks
+		Level l;
+		l.width = width;
+		l.height = height;
+		l.blocksX = (width + 3) / 4;
+		l.reserved = 0;
+		l.offset = owned.size() / 4;
+		int blocksY = (height + 3) / 4;
+		owned.resize(owned.size() + (size_t)l.blocksX * blocksY * 16 * 4, 0);
+		levels.push_back(l);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				memcpy(&owned[texelIndex(l, x, y)], &level[((size_t)y * width + x) * 4], 4);
+			}
+		}
+		if (width == 1 && height == 1) break;
+
+		// next level, 2 x 2 box filter (the last row / column is repeated for odd sizes)
+		int w = glm::max(width / 2, 1);
+		int h = glm::max(height / 2, 1);
+		vector<uint8_t> next(w * h * 4);
+		for (int y = 0; y < h; y++) {
+			int y0 = glm::min(y * 2, height - 1), y1 = glm::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < w; x++) {
+				int x0 = glm::min(x * 2, width - 1), x1 = glm::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; c++) {
+					int sum = level[((size_t)y0 * width + x0) * 4 + c] + level[((size_t)y0 * width + x1) * 4 + c]
+						+ level[((size_t)y1 * width + x0) * 4 + c] + level[((size_t)y1 * width + x1) * 4 + c];
+					next[((size_t)y * w + x) * 4 + c] = (sum + 2) / 4;
+				}
+			}
+		}
+		level.swap(next);
+		width = w;
+		height = h;
+	}
+	texels = owned.data();
+	texelBytes = owned.size();
+}
+
+
+// .rtex files
+
+struct TextureFileHeader {
+	char magic[4];              // "RTEX"
+	uint32_t version;
+	uint32_t levelCount;
+	uint32_t reserved;
+	uint64_t stamp;
+	uint64_t texelOffset;       // from the start of the file, 64 byte aligned
+	uint64_t texelBytes;
+};
+
+static const uint32_t textureVersion = 1;
+
+bool TextureMap::save(const string& path, uint64_t stamp) const {
+	if (levels.empty()) return false;
+
+	uint64_t tableEnd = sizeof(TextureFileHeader) + levels.size() * sizeof(Level);
+	TextureFileHeader header = { { 'R', 'T', 'E', 'X' }, textureVersion, (uint32_t)levels.size(), 0,
+		stamp, (tableEnd + 63) & ~(uint64_t)63, texelBytes };
+
+	// other processes may have the old cache mapped, see MappedFile::replace()
+	string tempPath = MappedFile::tempPath(path);
+	ofstream out(tempPath, ios::binary);
+	if (!out) return false;
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)levels.data(), levels.size() * sizeof(Level));
+	const char zeros[64] = {};
+	out.write(zeros, header.texelOffset - tableEnd);
+	out.write((const char*)texels, texelBytes);
+	out.close();
+	if (!out) {
+		ofFile::removeFile(tempPath, false);
+		return false;
+	}
+	return MappedFile::replace(tempPath, path);
+}
+
+bool TextureMap::load(const string& path, uint64_t stamp) {
+	clear();
+	if (!file.open(path)) return false;
+
+	const TextureFileHeader* header = (const TextureFileHeader*)file.data();
+	bool ok = file.size() >= sizeof(TextureFileHeader) && memcmp(header->magic, "RTEX", 4) == 0 &&
+		header->version == textureVersion && header->stamp == stamp && header->levelCount > 0 &&
+		(file.size() - sizeof(TextureFileHeader)) / sizeof(Level) >= header->levelCount &&
+		header->texelOffset % 64 == 0 && header->texelOffset <= file.size() &&
+		file.size() - header->texelOffset >= header->texelBytes;
+
+	// every level has to lie inside the texels
+	const Level* table = (const Level*)(file.data() + sizeof(TextureFileHeader));
+	for (uint32_t i = 0; ok && i < header->levelCount; i++) {
+		const Level& l = table[i];
+		ok = l.width > 0 && l.height > 0 && l.blocksX == (l.width + 3) / 4 &&
+			l.offset <= header->texelBytes / 4 &&
+			header->texelBytes / 4 - l.offset >= (uint64_t)l.blocksX * ((l.height + 3) / 4) * 16;
+	}
+	if (!ok) {
+		clear();
+		return false;
+	}
+
+	levels.assign(table, table + header->levelCount);
+	texels = file.data() + header->texelOffset;
+	texelBytes = header->texelBytes;
+	return true;
+}
+
+static inline int wrap(int i, int n) {
+	i %= n;
+	return i < 0 ? i + n : i;
+}
+
+glm::vec4 TextureMap::bilinear(const Level& level, float u, float v) const {
+	float x = u * level.width - 0.5f;
+	float y = v * level.height - 0.5f;
+	float fx = floorf(x);
+	float fy = floorf(y);
+	float ax = x - fx;
+	float ay = y - fy;
+	int x0 = wrap((int)fx, level.width), x1 = wrap(x0 + 1, level.width);
+	int y0 = wrap((int)fy, level.height), y1 = wrap(y0 + 1, level.height);
+
+	const uint8_t* t00 = &texels[texelIndex(level, x0, y0)];
+	const uint8_t* t10 = &texels[texelIndex(level, x1, y0)];
+	const uint8_t* t01 = &texels[texelIndex(level, x0, y1)];
+	const uint8_t* t11 = &texels[texelIndex(level, x1, y1)];
+	glm::vec4 result;
+	for (int c = 0; c < 4; c++) {
+		float top = t00[c] + (t10[c] - t00[c]) * ax;
+		float bottom = t01[c] + (t11[c] - t01[c]) * ax;
+		result[c] = top + (bottom - top) * ay;
+	}
+	return result;
+}
+
+// trilinear: the two levels around the footprint, blended
+glm::vec4 TextureMap::sample(float u, float v, float footprint) const {
+	if (levels.empty()) return glm::vec4(0);
+
+	float lod = log2f(glm::max(footprint * glm::max(levels[0].width, levels[0].height), 1.0f));
+	lod = glm::min(lod, (float)(levels.size() - 1));
+	int level = (int)lod;
+	float blend = lod - level;
+
+	glm::vec4 result = bilinear(levels[level], u, v);
+	if (blend > 0 && level + 1 < (int)levels.size()) {
+		result += (bilinear(levels[level + 1], u, v) - result) * blend;
+	}
+	return result;
+}
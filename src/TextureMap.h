@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ofMain.h"
+#include "MappedFile.h"
+#include <cstdint>
+
+
+//  diffuse + specular texture converted once for rendering
+//
+//  both maps go into one rgba8 image, rgb from the diffuse map and the specular map's
+//  brightness in alpha, so a lookup reads one texel for both. every mip level is
+//  stored in 4 x 4 blocks of texels (64 bytes, one cache line), so the 2 x 2 texels
+//  of a bilinear lookup are nearly always in the same line. lookups are trilinear,
+//  the mip level comes from how big the pixel is on the texture
+//
+//  a converted texture can be saved as is (.rtex: header, level table, then the
+//  texels 64 byte aligned) and loaded again by mapping the file, lookups then read
+//  the texels straight from the mapping
+class TextureMap {
+public:
+	TextureMap() {}
+	TextureMap(const TextureMap&) = delete;
+	TextureMap& operator=(const TextureMap&) = delete;
+
+	// convert the maps, the specular map is resampled to the diffuse map's size
+	void build(const ofPixels& diffuse, const ofPixels& specular);
+	void clear();
+
+	// stamp is stored with the texture and has to match when it is loaded, anything
+	// that changes when the source images do
+	bool save(const string& path, uint64_t stamp) const;
+	bool load(const string& path, uint64_t stamp);
+	bool isMapped() const { return file.isOpen(); }
+
+	bool isEmpty() const { return levels.empty(); }
+	int getWidth() const { return levels.empty() ? 0 : levels[0].width; }
+	int getHeight() const { return levels.empty() ? 0 : levels[0].height; }
+	int getLevelCount() const { return (int)levels.size(); }
+	size_t getMemorySize() const { return texelBytes; }
+
+	// filtered rgb + specular (0 - 255) at u, v (wrapped around). footprint is the
+	// width of the pixel on the texture in texture coordinates, 1 = the whole texture
+	glm::vec4 sample(float u, float v, float footprint) const;
+
+private:
+	// also the level table of the file
+	struct Level {
+		int32_t width, height;
+		int32_t blocksX;        // 4 x 4 blocks per row
+		int32_t reserved;
+		uint64_t offset;        // of the level's first block in texels
+	};
+
+	glm::vec4 bilinear(const Level& level, float u, float v) const;
+	size_t texelIndex(const Level& level, int x, int y) const {
+		return (level.offset + ((y >> 2) * level.blocksX + (x >> 2)) * 16 + (y & 3) * 4 + (x & 3)) * 4;
+	}
+
+	vector<Level> levels;       // full size first, down to 1 x 1
+	const uint8_t* texels = nullptr;    // all levels, in owned or in the mapped file
+	size_t texelBytes = 0;
+	vector<uint8_t> owned;
+	MappedFile file;
+};
+
+// textures are shared by every object that uses them and never change once built
+typedef shared_ptr<const TextureMap> TextureHandle;
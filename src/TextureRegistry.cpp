@@ -0,0 +1,70 @@
+#include "TextureRegistry.h"
+#include <filesystem>
+
+
+void TextureRegistry::add(const string& name, const string& diffusePath, const string& specularPath) {
+	Entry& e = entries[name];
+	e.diffusePath = diffusePath;
+	e.specularPath = specularPath;
+	e.map.reset();
+}
+
+void TextureRegistry::addDefaults() {
+	add("Garage Paving", "garage-paving/11_garage paving PBR texture_DIFF.jpg", "garage-paving/11_garage paving PBR texture_SPEC.jpg");
+	add("Brick Wall", "brick-wall/38_brick wall_DIFF.jpg", "brick-wall/38_brick wall_SPEC.jpg");
+	add("Cobblestone Pavement", "cobblestone-pavement/13_cobblestone pavement PBR texture_DIFFUSE.jpg",
+		"cobblestone-pavement/13_cobblestone pavement PBR texture_SPEC.jpg");
+	add("Marble Floor", "marble-floor/44_marble floor_DIFF.jpg", "marble-floor/44_marble floor_SPEC.jpg");
+}
+
+// size and modification time of an image, 0 if it's missing
+static uint64_t fileStamp(const string& path) {
+	std::error_code error;
+	std::filesystem::path file(ofToDataPath(path));
+	uint64_t size = std::filesystem::file_size(file, error);
+	if (error) return 0;
+	uint64_t time = (uint64_t)std::filesystem::last_write_time(file, error).time_since_epoch().count();
+	if (error) time = 0;
+	return size * 0x9E3779B97F4A7C15ull ^ time;
+}
+
+// changes when either image is replaced or edited, even if its size stays the same
+static uint64_t sourceStamp(const string& diffusePath, const string& specularPath) {
+	return fileStamp(diffusePath) * 0x9E3779B97F4A7C15ull ^ fileStamp(specularPath);
+}
+
+TextureHandle TextureRegistry::get(const string& name) {
+	auto it = entries.find(name);
+	if (it == entries.end()) return NULL;
+
+	Entry& e = it->second;
+	TextureHandle handle = e.map.lock();
+	if (handle) return handle;
+
+	shared_ptr<TextureMap> texture = make_shared<TextureMap>();
+	string cachePath = ofToDataPath(ofFilePath::removeExt(e.diffusePath) + ".rtex");
+	uint64_t stamp = sourceStamp(e.diffusePath, e.specularPath);
+	if (texture->load(cachePath, stamp)) {
+		printf("mapped texture %s from %s\n", name.c_str(), cachePath.c_str());
+		e.map = texture;
+		return texture;
+	}
+
+	// the images are only needed to build the map, they go away again right after
+	ofPixels diffuse, specular;
+	if (!ofLoadImage(diffuse, e.diffusePath)) {
+		printf("TextureRegistry: could not load %s\n", e.diffusePath.c_str());
+		return NULL;
+	}
+	if (!ofLoadImage(specular, e.specularPath)) {
+		printf("TextureRegistry: could not load %s\n", e.specularPath.c_str());
+		return NULL;
+	}
+
+	texture->build(diffuse, specular);
+	printf("loaded texture %s (%dx%d, %d levels, %.1f MB)\n", name.c_str(), texture->getWidth(), texture->getHeight(),
+		texture->getLevelCount(), texture->getMemorySize() / (1024.0f * 1024.0f));
+	if (!texture->save(cachePath, stamp)) printf("TextureRegistry: could not write %s\n", cachePath.c_str());
+	e.map = texture;
+	return texture;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ofMain.h"
+#include "TextureMap.h"
+
+
+//  textures by name, shared by every object that uses them
+//
+//  scene objects only hold a TextureHandle, so applying a texture is a lookup and
+//  a reference count, not a copy of the images. a texture is loaded (and converted)
+//  the first time it is asked for and stays loaded as long as something holds a
+//  handle to it, once the last one is gone its memory is freed
+//
+//  converted textures are cached next to the diffuse map (<diffuse map>.rtex). the
+//  first load decodes the images and writes the cache, later ones just map the cache
+//  file, which is only rebuilt when the images change
+class TextureRegistry {
+public:
+	// make a texture available under name, nothing is loaded yet
+	void add(const string& name, const string& diffusePath, const string& specularPath);
+
+	// the textures that come with the app, the names are the ones in scene files
+	void addDefaults();
+
+	// handle to the named texture, loads it if nothing uses it yet. NULL for unknown
+	// names and maps that can't be loaded
+	TextureHandle get(const string& name);
+
+private:
+	struct Entry {
+		string diffusePath, specularPath;
+		weak_ptr<const TextureMap> map;     // doesn't keep the texture loaded
+	};
+	map<string, Entry> entries;
+};
@@ -0,0 +1,140 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+
+
+TileScheduler::TileScheduler(int threads) {
+	pending = 0;
+	setThreadCount(threads);
+}
+
+TileScheduler::~TileScheduler() {
+	stopWorkers();
+}
+
+void TileScheduler::setThreadCount(int threads) {
+	if (threads <= 0) {
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	if (threads == threadCount) return;
+
+	stopWorkers();
+	threadCount = threads;
+
+	queues.clear();
+	for (int i = 0; i < threadCount; i++) {
+		queues.push_back(std::unique_ptr<TileQueue>(new TileQueue()));
+	}
+	startWorkers();
+}
+
+void TileScheduler::startWorkers() {
+	quit = false;
+
+	// worker 0 is whichever thread calls run()
+	for (int i = 1; i < threadCount; i++) {
+		workers.push_back(std::thread(&TileScheduler::workerThread, this, i));
+	}
+}
+
+void TileScheduler::stopWorkers() {
+	{
+		std::lock_guard<std::mutex> lk(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& t : workers) {
+		t.join();
+	}
+	workers.clear();
+}
+
+void TileScheduler::run(int width, int height, int tileSize, const TileFunction& fn) {
+	if (width <= 0 || height <= 0) return;
+	tileSize = std::max(1, tileSize);
+
+	// cut the image into tiles in scanline order
+	std::vector<RenderTile> tiles;
+	for (int y = 0; y < height; y += tileSize) {
+		for (int x = 0; x < width; x += tileSize) {
+			tiles.push_back({ x, y, std::min(x + tileSize, width), std::min(y + tileSize, height) });
+		}
+	}
+
+	// job and counter have to be set before any tile becomes visible to a worker
+	job = &fn;
+	pending = (int)tiles.size();
+
+	// hand out contiguous runs of tiles so each worker starts on a coherent region
+	size_t perThread = (tiles.size() + threadCount - 1) / threadCount;
+	for (int q = 0; q < threadCount; q++) {
+		std::lock_guard<std::mutex> lk(queues[q]->lock);
+		size_t first = std::min(tiles.size(), q * perThread);
+		size_t last = std::min(tiles.size(), first + perThread);
+		queues[q]->tiles.assign(tiles.begin() + first, tiles.begin() + last);
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(mutex);
+		generation++;
+	}
+	wake.notify_all();
+
+	// the calling thread works as well, then waits for tiles still in flight
+	workOnTiles(0);
+
+	std::unique_lock<std::mutex> lk(mutex);
+	done.wait(lk, [this] { return pending == 0; });
+	job = nullptr;
+}
+
+void TileScheduler::workerThread(int index) {
+	unsigned int seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lk(mutex);
+			wake.wait(lk, [&] { return quit || generation != seen; });
+			if (quit) return;
+			seen = generation;
+		}
+		workOnTiles(index);
+	}
+}
+
+void TileScheduler::workOnTiles(int index) {
+	RenderTile tile;
+	while (popTile(index, tile)) {
+		(*job)(tile, index);
+
+		if (--pending == 0) {
+			std::lock_guard<std::mutex> lk(mutex);
+			done.notify_all();
+		}
+	}
+}
+
+// take the most recent tile from our own queue, otherwise steal the oldest tile
+// of another worker
+bool TileScheduler::popTile(int index, RenderTile& tile) {
+	{
+		TileQueue& own = *queues[index];
+		std::lock_guard<std::mutex> lk(own.lock);
+		if (!own.tiles.empty()) {
+			tile = own.tiles.back();
+			own.tiles.pop_back();
+			return true;
+		}
+	}
+
+	for (int k = 1; k < threadCount; k++) {
+		TileQueue& victim = *queues[(index + k) % threadCount];
+		std::lock_guard<std::mutex> lk(victim.lock);
+		if (!victim.tiles.empty()) {
+			tile = victim.tiles.front();
+			victim.tiles.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
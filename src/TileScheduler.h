@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// rectangular block of image pixels, covers [x0, x1) x [y0, y1)
+struct RenderTile {
+	int x0, y0, x1, y1;
+};
+
+typedef std::function<void(const RenderTile& tile, int thread)> TileFunction;
+
+
+// tile based render scheduler backed by a work-stealing thread pool
+//
+// every worker owns a queue of tiles; it takes work from the back of its own queue
+// and, once that runs dry, steals from the front of the other queues. the calling
+// thread joins in as worker 0, so a thread count of 1 never starts a thread at all.
+class TileScheduler {
+public:
+	TileScheduler(int threads = 0);
+	~TileScheduler();
+
+	// 0 = one thread per hardware core
+	void setThreadCount(int threads);
+	int getThreadCount() const { return threadCount; }
+
+	// split a width x height image into square tiles and call fn on each of them,
+	// returns once every tile has been rendered
+	void run(int width, int height, int tileSize, const TileFunction& fn);
+
+private:
+	struct TileQueue {
+		std::mutex lock;
+		std::deque<RenderTile> tiles;
+	};
+
+	void startWorkers();
+	void stopWorkers();
+	void workerThread(int index);
+	void workOnTiles(int index);
+	bool popTile(int index, RenderTile& tile);
+
+	int threadCount = 0;
+	std::vector<std::unique_ptr<TileQueue>> queues;
+	std::vector<std::thread> workers;
+
+	// current job, shared by all workers
+	const TileFunction* job = nullptr;
+	std::atomic<int> pending;
+
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	unsigned int generation = 0;
+	bool quit = false;
+};
@@ -1,8 +1,15 @@
 #include "ofMain.h"
 #include "ofApp.h"
 
+int headlessMain(int argc, char* argv[]);   // mainHeadless.cpp
+
 //========================================================================
-int main( ){
+int main(int argc, char* argv[]){
+	// command line renders never open a window
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--headless") return headlessMain(argc, argv);
+	}
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
@@ -0,0 +1,340 @@
+#include "ofMain.h"
+#include "Renderer.h"
+#include "SceneFile.h"
+#include "TextureRegistry.h"
+#include "MandelbulbDE.h"
+
+//  headless batch renderer, renders a scene straight to an image file without
+//  opening a window or creating a GL context
+//
+//  usage: RayTracer --headless [options]
+//    --scene <name|file>         built in scene (default, spheres, menger, mandelbulb)
+//                                or a .scene / .rtsb scene file
+//    --save-scene <file>         also write the scene out, e.g. to convert text to binary
+//    --mode <raytrace|raymarch>  (default raytrace)
+//    --size <width>x<height>     (default 1200x800)
+//    --eye <x,y,z>               camera position (default 0,0,10 or the scene file's camera)
+//    --target <x,y,z>            point the camera looks at (default 0,0,0)
+//    --fov <degrees>             vertical field of view (default 60)
+//    --shading <none|lambert|phong>
+//    --threads <n>               render threads, 0 = all cores
+//    --seed <n>                  random seed for area light sampling
+//    --spp <n>                   samples per pixel, averaged in a float image, up to 64 (default 1)
+//    --edge-samples <n>          samples per pixel along edges, adaptive anti-aliasing, up to 64 (default off)
+//    --edge-contrast <c>         color difference between neighbours that makes an edge (default 0.1)
+//    --tonemap <clamp|soft|reinhard>  float image to 8 bit, soft rolls highlights off (default clamp)
+//    --exposure <factor>         scales the image before tone mapping (default 1)
+//    --sampler <random|stratified|sobol|bluenoise>  points on area lights (default sobol)
+//    --adaptive <on|off>         probe area lights first, all their shadow rays only in the
+//                                penumbra, can miss small shadows (default off)
+//    --probes <n>                probe rays per area light (default 8)
+//    --simd <scalar|sse|avx2>    force the ray packet kernels (default: best the cpu supports)
+//    --relax <factor>            over-relaxed ray marching, 1 (default) = plain sphere tracing
+//    --cone <on|off>             cone marching pre-pass for ray marching (default off)
+//    --shadows <sampled|penumbra>  ray marched area light shadows: a ray per light sample or
+//                                one march per light with an estimated penumbra (default: the scene's)
+//    --out <file>                output image (default render.png)
+//    --validate-mandelbulb       check the fast mandelbulb estimator against the reference and exit
+//    --bench-scene <n>           time opening a binary scene of n spheres and exit
+//
+//  scene files are rendered straight from their records, no scene objects are created
+//  for them. textures are loaded from the cache the gui app writes next to them (data/),
+//  the first run converts and caches them if it isn't there yet
+
+
+static void printUsage() {
+	printf("usage: RayTracer --headless [--scene name|file] [--save-scene file] [--mode raytrace|raymarch] [--size WxH]\n"
+		"                  [--eye x,y,z] [--target x,y,z] [--fov degrees] [--shading none|lambert|phong]\n"
+		"                  [--threads n] [--seed n] [--spp n] [--edge-samples n] [--edge-contrast c]\n"
+		"                  [--tonemap clamp|soft|reinhard] [--exposure factor]\n"
+		"                  [--sampler random|stratified|sobol|bluenoise] [--adaptive on|off] [--probes n]\n"
+		"                  [--simd scalar|sse|avx2] [--relax factor] [--cone on|off] [--shadows sampled|penumbra] [--out file]\n"
+		"       RayTracer --headless --validate-mandelbulb\n"
+		"       RayTracer --headless --bench-scene n\n");
+}
+
+static bool parseVec3(const string& s, glm::vec3& v) {
+	vector<string> parts = ofSplitString(s, ",", true, true);
+	if (parts.size() != 3) return false;
+	v = glm::vec3(ofToFloat(parts[0]), ofToFloat(parts[1]), ofToFloat(parts[2]));
+	return true;
+}
+
+// same test scenes as the ones set up (or commented out) in ofApp::setup()
+static bool buildScene(const string& name, vector<SceneObject*>& scene, vector<Light*>& lights) {
+	lights.push_back(new PointLight(glm::vec3(5, 8, 0), 200));
+	lights.push_back(new PointLight(glm::vec3(-3, 10, 0), 100));
+	lights.push_back(new AreaLight(glm::vec3(0, 10, 0), 10, 5, 5, 10, 10, 1));
+
+	scene.push_back(new Plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0), ofColor::darkGray));
+
+	if (name == "default") {
+		return true;
+	}
+	else if (name == "spheres") {
+		scene.push_back(new Sphere(glm::vec3(0, 1, -2), 2.0, ofColor::lightBlue));
+		scene.push_back(new Sphere(glm::vec3(-2.5, 0, 0), 1.0, ofColor::pink));
+		return true;
+	}
+	else if (name == "menger") {
+		scene.push_back(new MengerSponge(glm::vec3(0, 0, 0), ofColor::orange, 3, 2));
+		return true;
+	}
+	else if (name == "mandelbulb") {
+		scene.push_back(new Mandelbulb(glm::vec3(0, 0, 0), ofColor::yellow, 5, 8, 10));
+		return true;
+	}
+	return false;
+}
+
+// write a binary scene of a grid of spheres, then time opening it for rendering: mapping
+// the file plus building the render snapshot from its records, against creating the
+// scene objects for them. fails when the records aren't the faster way
+static bool benchSceneLoad(int objects) {
+	string path = ofToDataPath("bench-" + ofToString(objects) + ".rtsb");
+	{
+		SceneData data;
+		MaterialRecord m;
+		memset(&m, 0, sizeof(m));
+		memset(m.specular, 255, sizeof(m.specular));
+		m.numTiles = 1;
+		strncpy(m.texture, "None", sizeof(m.texture) - 1);
+
+		int side = (int)ceilf(sqrtf((float)objects));
+		for (int i = 0; i < objects; i++) {
+			m.diffuse[0] = (uint8_t)(i * 37);
+			m.diffuse[1] = (uint8_t)(i * 11);
+			m.diffuse[2] = 200;
+			m.diffuse[3] = 255;
+			SphereRecord s;
+			s.position = glm::vec3(i % side - side / 2, -1, -(i / side));
+			s.radius = 0.4f;
+			s.material = data.addMaterial(m);
+			data.addSphere(s);
+		}
+		data.addLight({ LIGHT_POINT, glm::vec3(5, 8, 0), 200, 0, 0, 0, 0, 0, SHADOW_SAMPLED });
+		if (!SceneFile::saveBinary(path, data)) return false;
+	}
+
+	TextureRegistry textures;
+	textures.addDefaults();
+
+	float start = ofGetElapsedTimef();
+	SceneData data;
+	if (!SceneFile::loadBinary(path, data)) return false;
+	float mapped = ofGetElapsedTimef();
+	RenderScene snapshot;
+	snapshot.build(data, textures);
+	float records = ofGetElapsedTimef();
+
+	vector<SceneObject*> scene;
+	vector<Light*> lights;
+	SceneFile::instantiate(data, scene, lights);
+	RenderScene fromObjects;
+	fromObjects.build(scene);
+	float instantiated = ofGetElapsedTimef();
+	for (SceneObject* obj : scene) delete obj;
+	for (Light* light : lights) delete light;
+	ofFile::removeFile(path);
+
+	bool ok = snapshot.objectCount() == objects && fromObjects.objectCount() == objects &&
+		records - start < instantiated - records;
+	printf("%d object scene: mapped in %.2f ms, snapshot from the records %.2f ms, from scene objects %.2f ms: %s\n",
+		objects, (mapped - start) * 1000, (records - mapped) * 1000, (instantiated - records) * 1000, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int headlessMain(int argc, char* argv[]) {
+	// no window, so scene objects must not build their gui panels
+	SceneObject::bHeadless = true;
+	ofInit();
+
+	string sceneName = "default";
+	string outFile = "render.png";
+	string saveSceneFile;
+	string shadowMode;          // empty = keep the scene's
+	RenderMode mode = RENDER_RAYTRACE;
+	int width = 1200;
+	int height = 800;
+	CameraRecord camera;
+	bool cameraSet = false;
+
+	Renderer renderer;
+	RenderSettings& settings = renderer.settings;
+	ToneMapping tone;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--headless") continue;
+		if (arg == "--validate-mandelbulb") return validateMandelbulbDE(100000, 1) ? 0 : 1;
+
+		if (i + 1 >= argc) {
+			printf("missing value for %s\n", arg.c_str());
+			printUsage();
+			return 1;
+		}
+		string value = argv[++i];
+
+		if (arg == "--bench-scene") return benchSceneLoad(glm::max(ofToInt(value), 1)) ? 0 : 1;
+
+		bool ok = true;
+		if (arg == "--scene") sceneName = value;
+		else if (arg == "--out") outFile = value;
+		else if (arg == "--save-scene") saveSceneFile = value;
+		else if (arg == "--mode") {
+			if (value == "raytrace") mode = RENDER_RAYTRACE;
+			else if (value == "raymarch") mode = RENDER_RAYMARCH;
+			else ok = false;
+		}
+		else if (arg == "--size") {
+			vector<string> dims = ofSplitString(value, "x");
+			ok = dims.size() == 2;
+			if (ok) {
+				width = ofToInt(dims[0]);
+				height = ofToInt(dims[1]);
+				ok = width > 0 && height > 0;
+			}
+		}
+		else if (arg == "--eye") ok = cameraSet = parseVec3(value, camera.eye);
+		else if (arg == "--target") ok = cameraSet = parseVec3(value, camera.target);
+		else if (arg == "--fov") {
+			camera.fov = ofToFloat(value);
+			cameraSet = true;
+		}
+		else if (arg == "--shading") {
+			settings.lambertShading = value == "lambert";
+			settings.phongShading = value == "phong";
+			ok = settings.lambertShading || settings.phongShading || value == "none";
+		}
+		else if (arg == "--threads") settings.threads = ofToInt(value);
+		else if (arg == "--seed") settings.seed = ofToInt(value);
+		else if (arg == "--spp") {
+			settings.samplesPerPixel = ofToInt(value);
+			ok = settings.samplesPerPixel > 0 && settings.samplesPerPixel <= RenderSettings::maxSamplesPerPixel;
+		}
+		else if (arg == "--edge-samples") {
+			settings.edgeSamples = ofToInt(value);
+			ok = settings.edgeSamples >= 0 && settings.edgeSamples <= RenderSettings::maxSamplesPerPixel;
+		}
+		else if (arg == "--edge-contrast") {
+			settings.edgeContrast = ofToFloat(value);
+			ok = settings.edgeContrast > 0;
+		}
+		else if (arg == "--tonemap") ok = ToneMapping::parse(value, tone.op);
+		else if (arg == "--exposure") {
+			tone.exposure = ofToFloat(value);
+			ok = tone.exposure > 0;
+		}
+		else if (arg == "--sampler") ok = Sampler::parse(value, settings.lightSampler);
+		else if (arg == "--adaptive") {
+			settings.adaptiveShadows = value == "on";
+			ok = settings.adaptiveShadows || value == "off";
+		}
+		else if (arg == "--probes") {
+			settings.shadowProbes = ofToInt(value);
+			ok = settings.shadowProbes > 0;
+		}
+		else if (arg == "--simd") ok = PacketKernels::select(value);
+		else if (arg == "--cone") {
+			settings.conePrepass = value == "on";
+			ok = settings.conePrepass || value == "off";
+		}
+		else if (arg == "--shadows") {
+			shadowMode = value;
+			ok = value == "sampled" || value == "penumbra";
+		}
+		else if (arg == "--relax") {
+			settings.relaxation = ofToFloat(value);
+			ok = settings.relaxation >= 1 && settings.relaxation < 2;
+		}
+		else ok = false;
+
+		if (!ok) {
+			printf("bad argument: %s %s\n", arg.c_str(), value.c_str());
+			printUsage();
+			return 1;
+		}
+	}
+
+	vector<SceneObject*> scene;
+	vector<Light*> lights;
+	SceneData data;             // scene files are rendered from these, they have no scene objects
+	string ext = ofToLower(ofFilePath::getFileExt(sceneName));
+	bool sceneFile = ext == "scene" || ext == "rtsb";
+	if (sceneFile) {
+		float loadStart = ofGetElapsedTimef();
+		if (!SceneFile::load(sceneName, data)) return 1;
+		SceneFile::instantiateLights(data, lights);
+		printf("loaded %d objects from %s (%.1f ms%s)\n", (int)data.objectCount(), sceneName.c_str(),
+			(ofGetElapsedTimef() - loadStart) * 1000, data.isMapped() ? ", mapped" : "");
+
+		// command line camera options win over the file's camera
+		if (data.hasCamera && !cameraSet) camera = data.camera;
+	}
+	else if (!buildScene(sceneName, scene, lights)) {
+		printf("unknown scene: %s\n", sceneName.c_str());
+		return 1;
+	}
+
+	// only the textures the scene uses are loaded
+	TextureRegistry textures;
+	textures.addDefaults();
+	for (SceneObject* obj : scene) {
+		obj->textureMap = textures.get(obj->textureName);
+	}
+
+	if (!shadowMode.empty()) {
+		for (Light* light : lights) {
+			if (dynamic_cast<AreaLight*>(light)) light->shadowMode = shadowMode == "penumbra" ? SHADOW_PENUMBRA : SHADOW_SAMPLED;
+		}
+	}
+
+	// scene files are written out as loaded, with the camera the image is rendered from
+	if (!saveSceneFile.empty()) {
+		SceneData captured;
+		if (!sceneFile) SceneFile::capture(scene, lights, captured);
+		SceneData& out = sceneFile ? data : captured;
+		out.hasCamera = true;
+		out.camera = camera;
+		if (!SceneFile::save(saveSceneFile, out)) return 1;
+	}
+
+	RenderView view;
+	view.lookAt(camera.eye, camera.target, camera.up, camera.fov, width, height);
+
+	ofPixels pixels;
+	pixels.allocate(width, height, OF_PIXELS_RGB);
+
+	float startTime = ofGetElapsedTimef();
+	renderer.setToneMapping(tone);
+	if (sceneFile) {
+		RenderScene snapshot;
+		snapshot.build(data, textures);
+		renderer.render(mode, std::move(snapshot), lights, view, pixels);
+	}
+	else renderer.render(mode, scene, lights, view, pixels);
+	printf("%s %s %dx%d done (%.2fs, %d threads, %s kernels, %d samples per pixel)\n", mode == RENDER_RAYTRACE ? "rayTrace" : "rayMarch",
+		sceneName.c_str(), width, height, ofGetElapsedTimef() - startTime, renderer.scheduler.getThreadCount(),
+		PacketKernels::get().name, settings.samplesPerPixel);
+	if (settings.edgeSamples > settings.samplesPerPixel) {
+		printf("  adaptive anti-aliasing: %d edge pixels (%.1f%%) with %d samples\n", renderer.getEdgePixels(),
+			renderer.getEdgePixels() * 100.0f / (width * height), settings.edgeSamples);
+	}
+	if (mode == RENDER_RAYMARCH) {
+		const RenderStats& stats = renderer.getStats();
+		printf("  %.1f steps per primary ray, %.1f per shadow ray (relaxation %.2f), %llu sdf calls, %llu of them cones, %llu shadow rays\n",
+			stats.stepsPerPrimaryRay(), stats.stepsPerShadowRay(), settings.relaxation,
+			(unsigned long long)stats.sdfCalls(), (unsigned long long)stats.coneSteps, (unsigned long long)stats.shadowRays);
+	}
+	if (settings.adaptiveShadows) {
+		const RenderStats& stats = renderer.getStats();
+		printf("  adaptive shadows: %llu of %llu light samples answered by the probes (%.0f%%)\n",
+			(unsigned long long)stats.lightSamplesSkipped, (unsigned long long)stats.lightSamples, stats.skippedLightSamples() * 100);
+	}
+
+	if (!ofSaveImage(pixels, outFile)) {
+		printf("could not write %s\n", outFile.c_str());
+		return 1;
+	}
+	return 0;
+}
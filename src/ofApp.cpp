@@ -38,15 +38,8 @@ void ofApp::setup() {
 	// allocate space for rendered image
 	image.allocate(imageWidth, imageHeight, OF_IMAGE_COLOR);
 
-	// load texture maps
-	garageDiffuse.load("garage-paving/11_garage paving PBR texture_DIFF.jpg");
-	garageSpecular.load("garage-paving/11_garage paving PBR texture_SPEC.jpg");
-	brickDiffuse.load("brick-wall/38_brick wall_DIFF.jpg");
-	brickSpecular.load("brick-wall/38_brick wall_SPEC.jpg");
-	cobbleDiffuse.load("cobblestone-pavement/13_cobblestone pavement PBR texture_DIFFUSE.jpg");
-	cobbleSpecular.load("cobblestone-pavement/13_cobblestone pavement PBR texture_SPEC.jpg");
-	marbleDiffuse.load("marble-floor/44_marble floor_DIFF.jpg");
-	marbleSpecular.load("marble-floor/44_marble floor_SPEC.jpg");
+	// texture maps, loaded when an object first uses them
+	textureRegistry.addDefaults();
 
 
 	// create scene objects (for testing)
@@ -73,38 +66,32 @@ void ofApp::setup() {
 	scene.push_back(bulb1);*/
 
 	// test: assign texture maps to objects
-	/*floor->diffuseMap = garageDiffuse;
-	floor->specularMap = garageSpecular;
+	/*floor->textureMap = textureRegistry.get("Garage Paving");
 	floor->numTiles = 1;
 	floor->nTiles = 1;
 	floor->textureName = "Garage Paving";
 
-	backWall->diffuseMap = brickDiffuse;
-	backWall->specularMap = brickSpecular;
+	backWall->textureMap = textureRegistry.get("Brick Wall");
 	backWall->numTiles = 8;
 	backWall->nTiles = 8;
 	backWall->textureName = "Brick Wall";
 
-	leftWall->diffuseMap = brickDiffuse;
-	leftWall->specularMap = brickSpecular;
+	leftWall->textureMap = textureRegistry.get("Brick Wall");
 	leftWall->numTiles = 8;
 	leftWall->nTiles = 8;
 	leftWall->textureName = "Brick Wall";
 
-	rightWall->diffuseMap = brickDiffuse;
-	rightWall->specularMap = brickSpecular;
+	rightWall->textureMap = textureRegistry.get("Brick Wall");
 	rightWall->numTiles = 8;
 	rightWall->nTiles = 8;
 	rightWall->textureName = "Brick Wall";
 
-	sphere1->diffuseMap = cobbleDiffuse;
-	sphere1->specularMap = cobbleSpecular;
+	sphere1->textureMap = textureRegistry.get("Cobblestone Pavement");
 	sphere1->numTiles = sphere1->radius;
 	sphere1->nTiles = sphere1->radius;
 	sphere1->textureName = "Cobblestone Pavement";
 
-	sphere2->diffuseMap = marbleDiffuse;
-	sphere2->specularMap = marbleSpecular;
+	sphere2->textureMap = textureRegistry.get("Marble Floor");
 	sphere2->numTiles = sphere2->radius;
 	sphere2->nTiles = sphere2->radius;
 	sphere2->textureName = "Marble Floor";*/
@@ -112,9 +99,71 @@ void ofApp::setup() {
 
 void ofApp::update() {
 	ambientLight.intensity = ambientLightIntensity;
+	trackEdits();
+
+	// restart the render when the scene, lights, render cam or settings change
+	// while the image is shown, edited objects only re-render what they can change
+	if (bLiveRender && bRendered && (sceneGeneration != renderGeneration || getSettingsKey() != settingsKey)) {
+		if (!startIncrementalRender()) startRender(renderMode, false);
+	}
+
+	// more samples per pixel are added to the finished image, it isn't rendered again
+	if (bLiveRender && bRendered && !renderer.isRendering() &&
+		(samplesPerPixel > renderer.getSamplesDone() || edgeSamples > renderer.getEdgeSamplesDone())) {
+		renderer.settings.samplesPerPixel = samplesPerPixel;
+		renderer.settings.edgeSamples = edgeSamples;
+		if (renderer.refine()) {
+			renderStartTime = ofGetElapsedTimef();
+			bSaveRender = bSaveRender && bRenderPending;
+			bRenderPending = true;
+			bIncremental = false;
+			bRefine = true;
+		}
+	}
+
+	ToneMapping tone;
+	tone.op = toneOperator;
+	tone.exposure = exposure;
+	ToneMapping current = renderer.getToneMapping();
+	if (tone.op != current.op || tone.exposure != current.exposure) renderer.setToneMapping(tone);
+
+	if (bRenderPending && renderer.isFinished()) {
+		bRenderPending = false;
+		if (renderer.fetch(image.getPixels())) image.update();
+
+		const char* name = renderMode == RENDER_RAYTRACE ? "rayTrace" : "rayMarch";
+		if (bIncremental) {
+			const RenderStats& stats = renderer.getStats();
+			printf("%s updated (%.2fs, %llu of %llu tiles)\n", name, ofGetElapsedTimef() - renderStartTime,
+				(unsigned long long)stats.tilesRendered, (unsigned long long)(stats.tilesRendered + stats.tilesSkipped));
+		}
+		else if (bRefine) printf("%s refined to %d samples per pixel (%.2fs)\n", name, renderer.getSamplesDone(), ofGetElapsedTimef() - renderStartTime);
+		else printf("%s done (%.2fs, %d threads, %d samples per pixel)\n", name, ofGetElapsedTimef() - renderStartTime,
+			renderer.scheduler.getThreadCount(), renderer.getSamplesDone());
+		if (renderer.getEdgeSamplesDone() > renderer.getSamplesDone()) {
+			printf("  adaptive anti-aliasing: %d edge pixels (%.1f%%) with %d samples\n", renderer.getEdgePixels(),
+				renderer.getEdgePixels() * 100.0f / (imageWidth * imageHeight), renderer.getEdgeSamplesDone());
+		}
+		if (renderMode == RENDER_RAYMARCH) {
+			const RenderStats& stats = renderer.getStats();
+			printf("  %.1f steps per primary ray, %.1f per shadow ray (relaxation %.2f), %llu sdf calls, %llu of them cones\n",
+				stats.stepsPerPrimaryRay(), stats.stepsPerShadowRay(), renderer.settings.relaxation,
+				(unsigned long long)stats.sdfCalls(), (unsigned long long)stats.coneSteps);
+		}
+		if (adaptiveShadows) {
+			const RenderStats& stats = renderer.getStats();
+			printf("  adaptive shadows: %llu of %llu light samples answered by the probes (%.0f%%)\n",
+				(unsigned long long)stats.lightSamplesSkipped, (unsigned long long)stats.lightSamples, stats.skippedLightSamples() * 100);
+		}
+		if (bSaveRender) {
+			if (renderMode == RENDER_RAYTRACE) image.save("/renderedImages/render" + to_string(ofApp::ext++) + ".png");
+			else image.save("/raymarching/render" + to_string(ofApp::rm++) + ".png");
+		}
+	}
 
 	if (objSelected()) {
 		// update parameters based on gui
+		selected[0]->ensureGUI();
 		selected[0]->updateGUI();
 	}
 	else {
@@ -154,7 +203,10 @@ void ofApp::draw() {
 	theCam->end();
 	ofDisableDepthTest();
 
-	// rendered image
+	// rendered image, with whatever the render threads have finished so far
+	if (renderer.fetch(image.getPixels())) {
+		image.update();
+	}
 	if (bRendered) {
 		image.draw((ofGetWindowWidth() / 2) - (imageWidth / 2), (ofGetWindowHeight() / 2) - (imageHeight / 2), imageWidth, imageHeight);
 	}
@@ -174,8 +226,7 @@ void ofApp::draw() {
 void ofApp::applyNoTexture(bool& val) {
 	if (objSelected() && noTexture) {
 		selected[0]->textureName = "None";
-		selected[0]->diffuseMap.clear();
-		selected[0]->specularMap.clear();
+		selected[0]->textureMap.reset();
 
 		brickWall = false;
 		garagePaving = false;
@@ -186,8 +237,7 @@ void ofApp::applyNoTexture(bool& val) {
 void ofApp::applyBrickWall(bool& val) {
 	if (objSelected() && brickWall) {
 		selected[0]->textureName = "Brick Wall";
-		selected[0]->diffuseMap = brickDiffuse;
-		selected[0]->specularMap = brickSpecular;
+		applyTextureByName(selected[0]);
 
 		noTexture = false;
 		garagePaving = false;
@@ -198,8 +248,7 @@ void ofApp::applyBrickWall(bool& val) {
 void ofApp::applyCobblestone(bool& val) {
 	if (objSelected() && cobblestonePavement) {
 		selected[0]->textureName = "Cobblestone Pavement";
-		selected[0]->diffuseMap = cobbleDiffuse;
-		selected[0]->specularMap = cobbleSpecular;
+		applyTextureByName(selected[0]);
 
 		noTexture = false;
 		garagePaving = false;
@@ -210,8 +259,7 @@ void ofApp::applyCobblestone(bool& val) {
 void ofApp::applyGaragePaving(bool& val) {
 	if (objSelected() && garagePaving) {
 		selected[0]->textureName = "Garage Paving";
-		selected[0]->diffuseMap = garageDiffuse;
-		selected[0]->specularMap = garageSpecular;
+		applyTextureByName(selected[0]);
 
 		noTexture = false;
 		brickWall = false;
@@ -222,8 +270,7 @@ void ofApp::applyGaragePaving(bool& val) {
 void ofApp::applyMarbleFloor(bool& val) {
 	if (objSelected() && marbleFloor) {
 		selected[0]->textureName = "Marble Floor";
-		selected[0]->diffuseMap = marbleDiffuse;
-		selected[0]->specularMap = marbleSpecular;
+		applyTextureByName(selected[0]);
 
 		noTexture = false;
 		garagePaving = false;
@@ -388,6 +435,7 @@ void ofApp::mousePressed(int x, int y, int button) {
 	if (selectedObj) {
 		selected.push_back(selectedObj);
 		selectedObj->bSelected = true;
+		selectedObj->ensureGUI();
 		bDrag = true;
 		mouseToDragPlane(x, y, lastPoint);
 	}
@@ -409,6 +457,13 @@ void ofApp::gotMessage(ofMessage msg) {}
 
 void ofApp::removeSelectedObject(SceneObject* obj) {
 
+	// where the object was has to be rendered again
+	AABB box;
+	obj->markEdited();
+	if (!dynamic_cast<Light*>(obj) && obj->takeEdit(box)) removedBounds.push_back(box);
+	else bRemovedUnbounded = true;
+	sceneGeneration++;
+
 	Light* light = dynamic_cast<Light*>(selected[0]);
 	if (light) { // obj is a light
 		for (int i = 0; i < lights.size(); i++) {
@@ -434,347 +489,287 @@ void ofApp::removeSelectedObject(SceneObject* obj) {
 
 void ofApp::addPlane() {
 	Plane* plane = new Plane();
+	plane->markEdited(true, AABB());
 	scene.push_back(plane);
+	sceneGeneration++;
 }
 
 void ofApp::addSphere() {
 	Sphere* sphere = new Sphere();
+	sphere->markEdited(true, AABB());
 	scene.push_back(sphere);
-	
+	sceneGeneration++;
 }
 
 void ofApp::addMengerSponge() {
 	MengerSponge* menger = new MengerSponge();
+	menger->markEdited(true, AABB());
 	scene.push_back(menger);
+	sceneGeneration++;
 }
 
 void ofApp::addMandelbulb() {
 	Mandelbulb* mandel = new Mandelbulb();
+	mandel->markEdited(true, AABB());
 	scene.push_back(mandel);
+	sceneGeneration++;
 }
 
 void ofApp::addPointLight() {
 	Light* light = new PointLight(glm::vec3(0, 10, 0));
+	light->markEdited();
 	lights.push_back(light);
+	sceneGeneration++;
 }
 
 void ofApp::addAreaLight() {
 	AreaLight* light = new AreaLight(glm::vec3(0, 10, 0));
+	light->markEdited();
 	lights.push_back(light);
+	sceneGeneration++;
 }
 
-
-int ofApp::ext = 0;
-int ofApp::rm = 0;
-
-
-// main ray trace loop, called by 'r' button
-void ofApp::rayTraceRender() {
-	printf("raytrace called...\n");
-	raytrace = true;
-
-	// offsets for getting ray
-	float w = (ofGetWindowWidth() - imageWidth) / 2;
-	float h = (ofGetWindowHeight() - imageHeight) / 2;
-
-	// go through each pixel in image
-	for (int i = 0; i < imageWidth; i++) {
-		for (int j = 0; j < imageHeight; j++) {
-
-			float u = (i + 0.5) / imageWidth;
-			float v = (j + 0.5) / imageHeight;
-
-			// render through the preview cam
-			glm::vec3 tmp = renderCam.screenToWorld(glm::vec3((u * imageWidth) + w, (v * imageHeight) + h, 0));
-			Ray ray = Ray(renderCam.getPosition(), glm::normalize(tmp - renderCam.getPosition()));
-
-			// variables to store information from intersection check
-			float distance = std::numeric_limits<float>::infinity();
-			glm::vec3 closestPoint;
-			glm::vec3 normalAtIntersect;
-			SceneObject* closestObject = NULL;
-
-			// check all objects in scene for intersection
-			for (SceneObject* object : scene) {
-				glm::vec3 point;
-				glm::vec3 normal;
-
-				// check intersection distance from camera
-				if (object->intersect(ray, point, normal)) {
-					float intersectDistance = glm::distance(ray.p, point);
-					if (intersectDistance < distance) {
-						closestObject = object;
-						closestPoint = point;
-						normalAtIntersect = normal;
-						distance = intersectDistance;
-					}
-				}
-			}
-
-			if (closestObject) {
-				// color pixel based on closestObject
-				ofColor color = colorPixel(closestObject, closestPoint, normalAtIntersect);
-				image.setColor(i, j, color);
-				
-			}
-			else {
-				// default to background color if no object
-				image.setColor(i, j, ofGetBackgroundColor());
-			}
-		}
+void ofApp::saveScene() {
+	ofFileDialogResult result = ofSystemSaveDialog("scene.scene", "Save scene (.scene = text, .rtsb = binary)");
+	if (result.bSuccess) {
+		saveSceneFile(result.getPath());
 	}
-
-	// update & save image
-	image.update();
-	image.save("/renderedImages/render" + to_string(ofApp::ext++) + ".png");
-	bRendered = true;
-
-	raytrace = false;
-	printf("rayTrace done\n");
 }
 
-// main ray march loop
-void ofApp::rayMarchRender() {
-	printf("rayMarch called...\n");
-	raymarch = true;
-
-	// offsets for getting ray
-	float w = (ofGetWindowWidth() - imageWidth) / 2;
-	float h = (ofGetWindowHeight() - imageHeight) / 2;
-
-	for (int i = 0; i < imageWidth; i++) {
-		for (int j = 0; j < imageHeight; j++) {
-
-			float u = (i + 0.5) / imageWidth;
-			float v = (j + 0.5) / imageHeight;
-
-			// render through the preview cam
-			glm::vec3 tmp = renderCam.screenToWorld(glm::vec3((u * imageWidth) + w, (v * imageHeight) + h, 0));
-			Ray ray = Ray(renderCam.getPosition(), glm::normalize(tmp - renderCam.getPosition()));
-
-
-			glm::vec3 p = ray.p;
-			int obj = -1;
-			bool hit = rayMarch(ray, p, obj);
-
-			SceneObject* closestObject = scene[obj]; // closest object to ray
-
-
-			// we hit the object, color the pixel
-			if (hit) {
-				ofColor color = colorPixel(closestObject, p, getNormalRM(p));
-				image.setColor(i, j, color);
-
-			}
-			else {
-				image.setColor(i, j, ofGetBackgroundColor());
-			}
-		}
+void ofApp::loadScene() {
+	ofFileDialogResult result = ofSystemLoadDialog("Load scene");
+	if (result.bSuccess) {
+		loadSceneFile(result.getPath());
 	}
+}
 
-	// update & save image
-	image.update();
-	image.save("/raymarching/render" + to_string(ofApp::rm++) + ".png");
-	bRendered = true;
-	
-	raymarch = false;
-	printf("rayMarch done\n");
+bool ofApp::saveSceneFile(const string& path) {
+	SceneData data;
+	data.hasCamera = true;
+	data.camera.eye = renderCam.getPosition();
+	data.camera.target = renderCam.getPosition() + renderCam.getLookAtDir();
+	data.camera.up = renderCam.getUpDir();
+	data.camera.fov = renderCam.getFov();
+	SceneFile::capture(scene, lights, data);
+
+	bool ok = SceneFile::save(path, data);
+	if (ok) printf("saved %d objects to %s\n", (int)data.objectCount(), path.c_str());
+	return ok;
 }
 
-// ray marching algorithm
-bool ofApp::rayMarch(const Ray& r, glm::vec3& p, int& obj) {
-	bool hit = false;
-	p = r.p;
-	float dist;
+// replace the current scene (objects, lights and render cam) with a scene file
+bool ofApp::loadSceneFile(const string& path) {
+	SceneData data;
+	if (!SceneFile::load(path, data)) return false;
 
-	for (int i = 0; i < maxRaySteps; i++) {
-		dist = sceneSDF(p, obj);
+	// the render threads still use the objects and lights that are deleted below
+	renderer.cancel();
 
-		if (dist < distThreshold) {
-			hit = true;
-			break;
-		}
-		else if (dist > maxDistance) {
-			break;
-		}
-		else {
-			p = p + (r.d * dist);
-		}
-	}
-
-	return hit;
-}
+	for (auto obj : selected) obj->bSelected = false;
+	selected.clear();
+	editObject = NULL;
+	for (auto obj : scene) delete obj;
+	for (auto l : lights) delete l;
+	scene.clear();
+	lights.clear();
+	sceneGeneration++;
+	areaLight = NULL;
 
-// checking scene for closest object in the scene
-float ofApp::sceneSDF(const glm::vec3& p, int& obj) {
-	float closest = std::numeric_limits<float>::infinity();
+	SceneFile::instantiate(data, scene, lights);
+	for (auto obj : scene) applyTextureByName(obj);
 
-	for (int i = 0; i < scene.size(); i++) {
-		// push back p (ray position) by obj's position
-		float dist = scene[i]->sdf(p - scene[i]->position);
-		if (dist < closest) {
-			closest = dist;
-			obj = i;
-		}
+	if (data.hasCamera) {
+		renderCam.setPosition(data.camera.eye);
+		renderCam.lookAt(data.camera.target, data.camera.up);
+		renderCam.setFov(data.camera.fov);
 	}
-	return closest;
-}
 
-float ofApp::sceneSDF(const glm::vec3& p) {
-	float closest = std::numeric_limits<float>::infinity();
-
-	for (int i = 0; i < scene.size(); i++) {
-		// push back p (ray position) by obj's position
-		float dist = scene[i]->sdf(p - scene[i]->position);
-		if (dist < closest) {
-			closest = dist;
-		}
-	}
-	return closest;
+	printf("loaded %d objects from %s\n", (int)data.objectCount(), path.c_str());
+	return true;
 }
 
-glm::vec3 ofApp::getNormalRM(const glm::vec3& p) {
-	float eps = normalEps;
-	float dp = sceneSDF(p);
-	glm::vec3 n(dp - sceneSDF(glm::vec3(p.x - eps, p.y, p.z)),
-		dp - sceneSDF(glm::vec3(p.x, p.y - eps, p.z)),
-		dp - sceneSDF(glm::vec3(p.x, p.y, p.z - eps)));
-	return glm::normalize(n);
+// objects only store the texture's name, get the shared maps that go with it
+void ofApp::applyTextureByName(SceneObject* obj) {
+	obj->textureMap = textureRegistry.get(obj->textureName);
+	if (!obj->textureMap) obj->textureName = "None";
 }
 
-// colors the pixel based on the object at that pixel
-ofColor ofApp::colorPixel(SceneObject* obj, const glm::vec3& p, glm::vec3 n) {
-
-	// default values if object has no texture/shading type not selected
-	ofColor color = obj->diffuseColor;
-	float specular = phongPower;
-
-	// check for textures obj->textureName != "None"
-	if (obj->diffuseMap.isAllocated() && obj->specularMap.isAllocated()) {
-		//printf("applying texture...\n");
-
-		// check object type (only plane/sphere)
-		Plane* plane = dynamic_cast<Plane*>(obj);
-		Sphere* sphere = dynamic_cast<Sphere*>(obj);
-		MengerSponge* menger = dynamic_cast<MengerSponge*>(obj);
 
-		// texture coordinates depend on object type
-		float texU, texV;
-		if (plane) {
-			plane->getTextureCoords(p, texU, texV);
-		}
-		if (sphere) {
-			sphere->getTextureCoords(p, texU, texV);
-		}
-		if (menger) { // who knows if this will work
-			float dist = std::numeric_limits<float>::infinity();
-			int face = -1;
-			vector<Plane*> faces = menger->faces;
-			for (int i = 0; i < faces.size(); i++) {
-				float d = distance(faces[i]->position, p);
-				if (d  < dist) {
-					dist = d;
-					face = i;
-				}
-			}
-			faces[face]->getTextureCoords(p, texU, texV);
-		}
+int ofApp::ext = 0;
+int ofApp::rm = 0;
 
-		// get texture color from diffuse map
-		float diffuseX = texU * obj->diffuseMap.getWidth();
-		float diffuseY = texV * obj->diffuseMap.getHeight();
-		diffuseX = ofClamp(diffuseX, 0, obj->diffuseMap.getWidth() - 1);
-		diffuseY = ofClamp(diffuseY, 0, obj->diffuseMap.getHeight() - 1);
-		color = obj->diffuseMap.getColor(diffuseX, diffuseY);
-
-		// get specular coefficient from specular map
-		if (phongShading) {
-			int specX = texU * obj->specularMap.getWidth();
-			int specY = texV * obj->specularMap.getHeight();
-			specX = ofClamp(specX, 0, obj->specularMap.getWidth() - 1);
-			specY = ofClamp(specY, 0, obj->specularMap.getHeight() - 1);
-			specular = obj->specularMap.getColor(specX, specY).getBrightness();
-		}
-		
-	}
-	
-	// apply shading if selected
-	if (lambertShading || phongShading) {
-		color = shading(p, n, color, ofColor::white, specular);
-	}
 
-	return color;
+// main ray trace loop, called by 'r' button
+void ofApp::rayTraceRender() {
+	startRender(RENDER_RAYTRACE, true);
 }
 
-// shading (lambert / phong)
-ofColor ofApp::shading(const glm::vec3& p, const glm::vec3& norm,
-	const ofColor diffuse, const ofColor specular, float power) {
+// main ray march loop
+void ofApp::rayMarchRender() {
+	startRender(RENDER_RAYMARCH, true);
+}
 
-	ofColor result = ambientLight.intensity * diffuse;
-	float totalDiffuse = 0;
-	float totalSpecular = 0;
+// progressive render in the background, the image fills in from draw() and the render
+// starts over whenever something it depends on changes
+void ofApp::startRender(RenderMode mode, bool save) {
+	if (save) printf("%s called...\n", mode == RENDER_RAYTRACE ? "rayTrace" : "rayMarch");
+
+	// settings are only changed while no render threads read them
+	renderer.cancel();
+	updateRenderSettings();
+	renderer.start(mode, scene, lights, getRenderView(), imageWidth, imageHeight);
+
+	// the whole image is rendered, the edits so far are covered
+	vector<AABB> edits;
+	takeEdits(edits);
+
+	renderMode = mode;
+	renderGeneration = sceneGeneration;
+	settingsKey = getSettingsKey();
+	bIncremental = false;
+	bRefine = false;
+	renderStartTime = ofGetElapsedTimef();
+	bLiveRender = true;
+	bSaveRender = save || (bSaveRender && bRenderPending);     // still save a restarted 'r' / 'm' render
+	bRenderPending = true;
+	bRendered = true;
+}
 
-	for (auto light : lights) {
-		if (light->intensity <= 0) continue; // skip lights with no "light"
+// copy the gui's render options over to the renderer
+void ofApp::updateRenderSettings() {
+	RenderSettings& rs = renderer.settings;
+	rs.lambertShading = lambertShading;
+	rs.phongShading = phongShading;
+	rs.phongPower = phongPower;
+	rs.ambientIntensity = ambientLight.intensity;
+	rs.background = ofGetBackgroundColor();
+	rs.threads = renderThreads;
+	rs.seed = renderSeed;
+	rs.relaxation = relaxedMarching ? relaxation : 1.0f;
+	rs.conePrepass = conePrepass;
+	rs.lightSampler = lightSampler;
+	rs.adaptiveShadows = adaptiveShadows;
+	rs.shadowProbes = shadowProbes;
+	rs.samplesPerPixel = samplesPerPixel;
+	rs.edgeSamples = edgeSamples;
+}
 
-		// calculate effect of lights
-		int numRays = light->getRaySamples(p, norm); // get ray(s) from light
-		for (int i = 0; i < numRays; i++) {
+// snapshot of the render cam for the render threads, pixels map to the same
+// screen positions as the image drawn in the middle of the window
+RenderView ofApp::getRenderView() {
+	// offsets for getting ray
+	float w = (ofGetWindowWidth() - imageWidth) / 2;
+	float h = (ofGetWindowHeight() - imageHeight) / 2;
 
-			bool shadow = false;
-			if (raytrace) shadow = inShadow(light->samples[i]);
-			if (raymarch) shadow = inShadowRM(light->samples[i]);
+	RenderView v;
+	v.eye = renderCam.getPosition();
+	v.origin = renderCam.screenToWorld(glm::vec3(w, h, 0));
+	v.du = (renderCam.screenToWorld(glm::vec3(w + imageWidth, h, 0)) - v.origin) / (float)imageWidth;
+	v.dv = (renderCam.screenToWorld(glm::vec3(w, h + imageHeight, 0)) - v.origin) / (float)imageHeight;
+	return v;
+}
 
-			if (!shadow) {
+// the render cam and render options a render depends on as raw bytes, they are plain
+// floats and ints so equal settings give equal keys. changes to the scene itself are
+// counted in sceneGeneration instead, that doesn't grow with the scene
+string ofApp::getSettingsKey() {
+	RenderView view = getRenderView();
+	ofColor background = ofGetBackgroundColor();
+	int ints[] = { imageWidth, imageHeight, lambertShading, phongShading, renderThreads, renderSeed, relaxedMarching, conePrepass, lightSampler, adaptiveShadows, shadowProbes };
+	float floats[] = { phongPower, ambientLightIntensity, relaxation };
+
+	string key;
+	auto add = [&](const void* bytes, size_t size) { key.append((const char*)bytes, size); };
+	add(&view, sizeof(view));
+	add(&background, sizeof(background));
+	add(ints, sizeof(ints));
+	add(floats, sizeof(floats));
+	return key;
+}
 
-				// calculate intensity of light with respect to distance
-				float distance = glm::length(light->samplesPos[i] - p);
-				float illumination = light->intensity / (distance * distance);
+// records as raw bytes, to compare them
+string ofApp::getRecordKey(const SceneData& data) {
+	string key;
+	auto add = [&](const void* bytes, size_t size) { key.append((const char*)bytes, size); };
+	add(data.materials.data, data.materials.size() * sizeof(MaterialRecord));
+	add(data.spheres.data, data.spheres.size() * sizeof(SphereRecord));
+	add(data.planes.data, data.planes.size() * sizeof(PlaneRecord));
+	add(data.mengers.data, data.mengers.size() * sizeof(MengerRecord));
+	add(data.mandelbulbs.data, data.mandelbulbs.size() * sizeof(MandelbulbRecord));
+	add(data.lights.data, data.lights.size() * sizeof(LightRecord));
+	return key;
+}
 
-				// lambert formula
-				glm::vec3 lightDirection = light->samples[i].d;
-				float lambertCalc = glm::max(glm::dot(norm, lightDirection), 0.0f);
-				totalDiffuse += lambertCalc * illumination;
+// records of a single object or light
+string ofApp::getObjectKey(SceneObject* obj) {
+	SceneData data;
+	Light* light = dynamic_cast<Light*>(obj);
+	if (light) SceneFile::capture({}, { light }, data);
+	else SceneFile::capture({ obj }, {}, data);
+	return getRecordKey(data);
+}
 
-				// specular formula
-				if (phongShading) {
-					glm::vec3 viewDirection = glm::normalize(renderCam.getPosition() - p);
-					glm::vec3 h = glm::normalize(viewDirection + lightDirection);
-					float specularCalc = glm::pow(glm::max(glm::dot(norm, h), 0.0f), power);
-					totalSpecular += specularCalc * illumination;
-				}
 
-			}
-		}
+// incremental rendering
 
-		result += (diffuse * (totalDiffuse / numRays)) + (specular * (totalSpecular / numRays));
+// notice edits of the selected object (its gui panel, dragging, the texture options)
+// by comparing its records with last frame's, it is marked edited with the bounds it
+// had before
+void ofApp::trackEdits() {
+	SceneObject* obj = objSelected() ? selected[0] : NULL;
+	if (!obj) {
+		editObject = NULL;
+		return;
 	}
 
-	return result;
+	string key = getObjectKey(obj);
+	if (obj == editObject && key != editKey) {
+		obj->markEdited(editBounded, editBounds);
+		sceneGeneration++;
+	}
+	editObject = obj;
+	editKey = key;
+	editBounded = obj->getBounds(editBounds);
 }
 
-
-// check if any object in the scene intersects the ray between the light and point
-bool ofApp::inShadow(Ray ray) {
-	for (auto obj : scene) {
-		glm::vec3 intersectPoint;
-		glm::vec3 normal;
-		// does not account for objects "above" light
-		if (obj->intersect(ray, intersectPoint, normal)) {
-			return true;
-		}
-	}
-	return false;
+// hand over the edits since the last render as world space boxes, false if one of
+// them has no bounds (lights reach every pixel, ray marched planes are infinite)
+bool ofApp::takeEdits(vector<AABB>& boxes) {
+	bool bounded = !bRemovedUnbounded;
+	boxes = removedBounds;
+	removedBounds.clear();
+	bRemovedUnbounded = false;
+
+	for (SceneObject* obj : scene) {
+		AABB box;
+		if (!obj->isEdited()) continue;
+		if (obj->takeEdit(box)) boxes.push_back(box);
+		else bounded = false;
+	}
+	for (Light* light : lights) {
+		AABB box;
+		if (!light->isEdited()) continue;
+		light->takeEdit(box);
+		bounded = false;
+	}
+	return bounded;
 }
 
-// ray marching: check to see if Point p is in a shadow cast by light shining along Ray r
-bool ofApp::inShadowRM(const Ray& r) {
-	for (int i = 0; i < scene.size(); i++) {
-		glm::vec3 point, normal;
-		int obj;
-		float eps = .08;    // to avoid self intersection 
-		if (rayMarch(Ray(r.p + r.d * eps, r.d), point, obj))
-			return true;
-	}
-	return false;
+// re-render only the tiles the object edits since the last render can have changed.
+// false when the whole image has to be rendered again: the render cam or settings
+// changed, an edit has no bounds or there is no finished image to update
+bool ofApp::startIncrementalRender() {
+	vector<AABB> boxes;
+	bool bounded = takeEdits(boxes);
+	if (!bounded || boxes.empty() || getSettingsKey() != settingsKey) return false;
+	if (!renderer.update(scene, lights, boxes)) return false;
+
+	renderGeneration = sceneGeneration;
+	renderStartTime = ofGetElapsedTimef();
+	bSaveRender = bSaveRender && bRenderPending;
+	bRenderPending = true;
+	bIncremental = true;
+	bRefine = false;
+	return true;
 }
+
@@ -3,6 +3,9 @@
 #include "ofMain.h"
 #include "ofxGui.h"
 #include "Primitives.h"
+#include "Renderer.h"
+#include "SceneFile.h"
+#include "TextureRegistry.h"
 #include <glm/gtx/intersect.hpp>
 
 
@@ -25,6 +28,12 @@ public:
 		gui.add(updateRender.setup("Update RenderCam (TAB)"));
 		gui.add(delObject.setup("Delete Selection (DEL)"));
 		
+		saveSceneButton.addListener(this, &ofApp::saveScene);
+		loadSceneButton.addListener(this, &ofApp::loadScene);
+
+		gui.add(saveSceneButton.setup("Save Scene"));
+		gui.add(loadSceneButton.setup("Load Scene"));
+
 		createPlane.addListener(this, &ofApp::addPlane);
 		createSphere.addListener(this, &ofApp::addSphere);
 		createMenger.addListener(this, &ofApp::addMengerSponge);
@@ -50,9 +59,25 @@ public:
 		imageSettings.add(bRendered.set("Show Image (I)", false));
 		imageSettings.add(res1200x800.set("1200 x 800", true));
 		imageSettings.add(res600x400.set("600 x 400", false));
+		imageSettings.add(renderThreads.set("Render Threads (0 = All)", 0, 0, 64));
+		imageSettings.add(renderSeed.set("Random Seed", 0, 0, 1000));
+		imageSettings.add(samplesPerPixel.set("Samples Per Pixel", 1, 1, RenderSettings::maxSamplesPerPixel));
+		imageSettings.add(edgeSamples.set("Edge Samples Per Pixel", 0, 0, RenderSettings::maxSamplesPerPixel));
 
 		gui.add(imageSettings);
 
+		clampTone.addListener(this, &ofApp::clampToneOnly);
+		softTone.addListener(this, &ofApp::softToneOnly);
+		reinhardTone.addListener(this, &ofApp::reinhardToneOnly);
+
+		toneSettings.setName("Tone Mapping");
+		toneSettings.add(clampTone.set("Clamp", true));
+		toneSettings.add(softTone.set("Soft Highlights", false));
+		toneSettings.add(reinhardTone.set("Reinhard", false));
+		toneSettings.add(exposure.set("Exposure", 1, 0.25, 4));
+
+		gui.add(toneSettings);
+
 		lambertShading.addListener(this, &ofApp::lambertOnly);
 		phongShading.addListener(this, &ofApp::phongOnly);
 
@@ -64,6 +89,28 @@ public:
 
 		gui.add(shadingSettings);
 
+		marchSettings.setName("Ray March Settings");
+		marchSettings.add(relaxedMarching.set("Over-Relaxed Marching", false));
+		marchSettings.add(relaxation.set("Relaxation", 1.5, 1, 1.95));
+		marchSettings.add(conePrepass.set("Cone Pre-Pass", false));
+
+		gui.add(marchSettings);
+
+		randomSampling.addListener(this, &ofApp::randomSamplingOnly);
+		stratifiedSampling.addListener(this, &ofApp::stratifiedSamplingOnly);
+		sobolSampling.addListener(this, &ofApp::sobolSamplingOnly);
+		blueNoiseSampling.addListener(this, &ofApp::blueNoiseSamplingOnly);
+
+		samplingSettings.setName("Area Light Sampling");
+		samplingSettings.add(randomSampling.set("Random", false));
+		samplingSettings.add(stratifiedSampling.set("Stratified", false));
+		samplingSettings.add(sobolSampling.set("Sobol (Owen Scrambled)", true));
+		samplingSettings.add(blueNoiseSampling.set("Blue Noise", false));
+		samplingSettings.add(adaptiveShadows.set("Adaptive Shadows", false));
+		samplingSettings.add(shadowProbes.set("Shadow Probes", 8, 2, 32));
+
+		gui.add(samplingSettings);
+
 		noTexture.addListener(this, &ofApp::applyNoTexture);
 		brickWall.addListener(this, &ofApp::applyBrickWall);
 		cobblestonePavement.addListener(this, &ofApp::applyCobblestone);
@@ -136,28 +183,46 @@ public:
 	}
 	void lambertOnly(bool& val) { if (lambertShading) phongShading = false; }
 	void phongOnly(bool& val) { if (phongShading) lambertShading = false; }
+	void randomSamplingOnly(bool& val) { if (val) selectSampler(SAMPLER_RANDOM); }
+	void stratifiedSamplingOnly(bool& val) { if (val) selectSampler(SAMPLER_STRATIFIED); }
+	void sobolSamplingOnly(bool& val) { if (val) selectSampler(SAMPLER_SOBOL); }
+	void blueNoiseSamplingOnly(bool& val) { if (val) selectSampler(SAMPLER_BLUE_NOISE); }
+	void selectSampler(SamplerType type) {
+		lightSampler = type;
+		if (type != SAMPLER_RANDOM) randomSampling = false;
+		if (type != SAMPLER_STRATIFIED) stratifiedSampling = false;
+		if (type != SAMPLER_SOBOL) sobolSampling = false;
+		if (type != SAMPLER_BLUE_NOISE) blueNoiseSampling = false;
+	}
+	void clampToneOnly(bool& val) { if (val) selectToneOperator(TONE_CLAMP); }
+	void softToneOnly(bool& val) { if (val) selectToneOperator(TONE_SOFT); }
+	void reinhardToneOnly(bool& val) { if (val) selectToneOperator(TONE_REINHARD); }
+	void selectToneOperator(ToneOperator op) {
+		toneOperator = op;
+		if (op != TONE_CLAMP) clampTone = false;
+		if (op != TONE_SOFT) softTone = false;
+		if (op != TONE_REINHARD) reinhardTone = false;
+	}
 	void applyNoTexture(bool& val);
 	void applyBrickWall(bool& val);
 	void applyCobblestone(bool& val);
 	void applyGaragePaving(bool& val);
 	void applyMarbleFloor(bool& val);
 
-	// raytrace functions
+	// rendering functions
 	void rayTraceRender();
-	bool inShadow(Ray ray);
-
-	// raymarch functions
 	void rayMarchRender();
-	bool rayMarch(const Ray& r, glm::vec3& p, int& obj);
-	float sceneSDF(const glm::vec3& p, int& obj);
-	float sceneSDF(const glm::vec3& p);
-	bool inShadowRM(const Ray& r);
-	glm::vec3 getNormalRM(const glm::vec3& p);
-
-	// general rendering functions
-	ofColor colorPixel(SceneObject* obj, const glm::vec3& p, glm::vec3 n);
-	ofColor shading(const glm::vec3& p, const glm::vec3& norm,
-		const ofColor diffuse, const ofColor specular, float power);
+	void startRender(RenderMode mode, bool save);
+	void updateRenderSettings();
+	RenderView getRenderView();
+	string getSettingsKey();
+	string getObjectKey(SceneObject* obj);
+	static string getRecordKey(const SceneData& data);
+
+	// incremental rendering
+	void trackEdits();
+	bool takeEdits(vector<AABB>& boxes);
+	bool startIncrementalRender();
 	
 	void drawGrid() {}
 
@@ -171,6 +236,13 @@ public:
 	void addPointLight();
 	void addAreaLight();
 
+	// scene files
+	void saveScene();
+	void loadScene();
+	bool saveSceneFile(const string& path);
+	bool loadSceneFile(const string& path);
+	void applyTextureByName(SceneObject* obj);
+
 	// camera objects
 	ofEasyCam mainCam;
 	ofEasyCam sideCam;
@@ -192,22 +264,32 @@ public:
 	ofImage image;
 	int imageWidth = 1200;
 	int imageHeight = 800;
-	bool raytrace = false;
-	bool raymarch = false;
 	static int ofApp::ext;
 	static int ofApp::rm;
-
-	// ray marching
-	int maxRaySteps = 1000;
-	float distThreshold = 0.01;
-	float maxDistance = 100;
-	float normalEps = 0.01;
+	Renderer renderer;
+
+	// progressive render, restarted when the scene or the settings change
+	bool bLiveRender = false;   // a render was started, keep it up to date
+	bool bRenderPending = false;
+	bool bSaveRender = false;   // save the image once the render is finished
+	RenderMode renderMode = RENDER_RAYTRACE;
+	uint64_t sceneGeneration = 0;   // counts every change to the objects and lights
+	uint64_t renderGeneration = 0;  // sceneGeneration the image was rendered from
+	string settingsKey;         // incremental renders only when this didn't change
+	bool bIncremental = false;  // the pending render only updates changed tiles
+	bool bRefine = false;       // the pending render only adds samples
+	float renderStartTime = 0;
+
+	// edit tracking, the selected object as it was last frame
+	SceneObject* editObject = NULL;
+	string editKey;
+	AABB editBounds;
+	bool editBounded = false;
+	vector<AABB> removedBounds;     // objects deleted since the last render
+	bool bRemovedUnbounded = false;
 
 	// texture maps
-	ofImage garageDiffuse, garageSpecular;
-	ofImage brickDiffuse, brickSpecular;
-	ofImage cobbleDiffuse, cobbleSpecular;
-	ofImage marbleDiffuse, marbleSpecular;
+	TextureRegistry textureRegistry;
 	
 	// state
 	map<int, bool> keymap;
@@ -219,6 +301,7 @@ public:
 	bool bHide = false;
 	ofParameter<bool> lockCamera;
 	ofxButton updateRender;
+	ofxButton saveSceneButton, loadSceneButton;
 	ofxLabel objSettings;
 	ofxButton createPlane, createSphere, createMenger, createMandelbulb, delObject;
 	ofxLabel lightSettings;
@@ -227,15 +310,36 @@ public:
 	// image settings
 	ofParameterGroup imageSettings;
 	ofParameter<bool> res600x400, res1200x800;
+	ofParameter<int> renderThreads, renderSeed;
+	ofParameter<int> samplesPerPixel;   // raised on a finished image, only the new samples are rendered
+	ofParameter<int> edgeSamples;       // adaptive anti-aliasing, off (0) when not above samplesPerPixel
 	ofxButton rayTraceScene, rayMarchScene;
 	ofParameter<bool> bRendered;
 
+	// tone mapping, one operator at a time. changes only map the rendered image again
+	ofParameterGroup toneSettings;
+	ofParameter<bool> clampTone, softTone, reinhardTone;
+	ToneOperator toneOperator = TONE_CLAMP;
+	ofParameter<float> exposure;
+
 	// renderOptions options
 	ofParameterGroup shadingSettings;
 	ofParameter<float> ambientLightIntensity;
 	ofParameter<bool> lambertShading, phongShading;
 	ofParameter<float> phongPower;
 
+	// ray marching options
+	ofParameterGroup marchSettings;
+	ofParameter<bool> relaxedMarching, conePrepass;
+	ofParameter<float> relaxation;
+
+	// area light sampling, one of the samplers at a time
+	ofParameterGroup samplingSettings;
+	ofParameter<bool> randomSampling, stratifiedSampling, sobolSampling, blueNoiseSampling;
+	SamplerType lightSampler = SAMPLER_SOBOL;
+	ofParameter<bool> adaptiveShadows;
+	ofParameter<int> shadowProbes;
+
 	// texture application
 	ofParameterGroup textures;
 	ofParameter<bool> noTexture;